@@ -0,0 +1,408 @@
+// Microbenchmarks for the simulation hot paths (make bench)
+//
+// Usage: double_pendulum_bench [results.json] [--quick]
+//
+// Every figure is the best of three timed runs, each repeated until it takes
+// at least MIN_SECONDS (a tenth of that with --quick). Results are printed
+// and written as JSON so runs can be compared over time.
+
+#include "DoublePendulum.hpp"
+#include "PendulumEnsemble.hpp"
+#include "SimdKernel.hpp"
+#include "ThreadPool.hpp"
+#include "Stepper.hpp"
+#include "DormandPrince.hpp"
+#include "TrajectoryWriter.hpp"
+#include "TrajectoryFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static double MIN_SECONDS = 0.2;
+
+// Keeps results alive so the compiler cannot drop the benchmarked work
+static volatile double sink;
+
+// One JSON object in one of the result arrays
+struct Measurement {
+    std::string group;
+    std::vector<std::pair<std::string, std::string>> fields;
+};
+
+static std::vector<Measurement> results;
+
+static std::string jsonString(const std::string& s) {
+    return "\"" + s + "\"";
+}
+
+static std::string jsonNumber(double value) {
+    std::ostringstream out;
+    out << std::setprecision(6) << value;
+    return out.str();
+}
+
+static void record(const std::string& group, const std::vector<std::pair<std::string, std::string>>& fields) {
+    results.push_back(Measurement{group, fields});
+
+    std::cout << "  ";
+    for (size_t i = 0; i < fields.size(); i++) {
+        std::cout << (i ? "  " : "") << fields[i].first << "=" << fields[i].second;
+    }
+    std::cout << std::endl;
+}
+
+// Seconds per iteration of fn(iterations): the count grows until one call
+// takes MIN_SECONDS, then the best of three calls is kept
+static double timePerIteration(const std::function<void(long)>& fn) {
+    typedef std::chrono::steady_clock Clock;
+
+    long iterations = 1;
+    while (true) {
+        Clock::time_point start = Clock::now();
+        fn(iterations);
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed >= MIN_SECONDS || iterations >= (1L << 40)) break;
+        double factor = elapsed > 0 ? std::min(16.0, std::max(2.0, 1.2 * MIN_SECONDS / elapsed)) : 16.0;
+        iterations = static_cast<long>(iterations * factor);
+    }
+
+    double best = 0.0;
+    for (int run = 0; run < 3; run++) {
+        Clock::time_point start = Clock::now();
+        fn(iterations);
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count() / iterations;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// The configuration of config/config with a step size usable by every method
+static Config benchConfig() {
+    Config cfg;
+    cfg.L1 = cfg.L2 = 1.0;
+    cfg.M1 = cfg.M2 = 1.0;
+    cfg.G = 9.8;
+    cfg.theta1 = 2.0;
+    cfg.theta2 = 1.0;
+    cfg.omega1 = 1.0;
+    cfg.omega2 = 0.0;
+    cfg.dt = 1e-3;
+    cfg.totalTime = 10.0;
+    return cfg;
+}
+
+// Levels this CPU can run, scalar first
+static std::vector<SimdLevel> supportedLevels() {
+    std::vector<SimdLevel> levels;
+    SimdLevel best = detectSimdLevel();
+    for (int level = SIMD_SCALAR; level <= best; level++) {
+        levels.push_back(static_cast<SimdLevel>(level));
+    }
+    return levels;
+}
+
+// Ensemble of n members spread over a grid of initial angles
+static void fillEnsemble(PendulumEnsemble& ensemble, size_t n) {
+    ensemble.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        double u = (i + 0.5) / n;
+        ensemble.addMember(-3.0 + 6.0 * u, 3.0 - 6.0 * u * u, 0.0, 0.0);
+    }
+    ensemble.initialize();
+}
+
+static void benchAcceleration(const Config& cfg) {
+    std::cout << "Acceleration kernels" << std::endl;
+
+    DoublePendulum pendulum(cfg);
+    double perCall = timePerIteration([&](long iterations) {
+        double sum = 0.0, alpha1, alpha2;
+        for (long i = 0; i < iterations; i++) {
+            pendulum.calculateAcceleration(alpha1, alpha2);
+            sum += alpha1 + alpha2;
+        }
+        sink = sum;
+    });
+    record("acceleration", {{"name", jsonString("calculateAcceleration")},
+                            {"ns_per_state", jsonNumber(perCall * 1e9)}});
+
+    // Batched kernels over varied states, per instruction set
+    const size_t n = 1024;
+    std::vector<double> theta1(n), theta2(n), omega1(n), omega2(n), alpha1(n), alpha2(n);
+    std::vector<unsigned> flags(n);
+    for (size_t i = 0; i < n; i++) {
+        theta1[i] = -3.0 + 6.0 * i / n;
+        theta2[i] = 1.5 - 3.0 * i / n;
+        omega1[i] = 0.01 * i;
+        omega2[i] = -0.02 * i;
+    }
+
+    for (SimdLevel level : supportedLevels()) {
+        AccelerationBatchFn kernel = selectAccelerationKernel(level);
+        double perBatch = timePerIteration([&](long iterations) {
+            for (long i = 0; i < iterations; i++) {
+                kernel(cfg, theta1.data(), theta2.data(), omega1.data(), omega2.data(),
+                       alpha1.data(), alpha2.data(), flags.data(), n);
+                sink = alpha1[i % n];
+            }
+        });
+        record("acceleration", {{"name", jsonString(std::string("batch_") + simdLevelName(level))},
+                                {"ns_per_state", jsonNumber(perBatch / n * 1e9)}});
+    }
+}
+
+static void benchIntegrators(const Config& base) {
+    std::cout << "Single pendulum integration (DT=" << base.dt << ")" << std::endl;
+
+    DoublePendulum pendulum(base);
+    pendulum.verletStep();
+    double perStep = timePerIteration([&](long iterations) {
+        for (long i = 0; i < iterations; i++) pendulum.verletStep();
+        sink = pendulum.getTheta1();
+    });
+    record("integrators", {{"method", jsonString("verletStep")},
+                           {"steps_per_second", jsonNumber(1.0 / perStep)},
+                           {"ns_per_step", jsonNumber(perStep * 1e9)}});
+
+    const char* methods[] = {"verlet", "midpoint", "stormer-verlet", "yoshida4", "yoshida6", "yoshida8"};
+    for (const char* method : methods) {
+        Config cfg = base;
+        cfg.method = method;
+        std::unique_ptr<Stepper> stepper = createStepper(cfg);
+        PendulumState state = {cfg.theta1, cfg.theta2, cfg.omega1, cfg.omega2, cfg.theta1, cfg.theta2};
+        stepper->start(state);
+
+        perStep = timePerIteration([&](long iterations) {
+            for (long i = 0; i < iterations; i++) stepper->step(state);
+            sink = state.theta1;
+        });
+        record("integrators", {{"method", jsonString(method)},
+                               {"steps_per_second", jsonNumber(1.0 / perStep)},
+                               {"ns_per_step", jsonNumber(perStep * 1e9)}});
+    }
+
+    // Adaptive steps: time per accepted step, rejected ones included
+    DormandPrince dopri(base);
+    double y[4] = {base.theta1, base.theta2, base.omega1, base.omega2};
+    dopri.reset(0.0, y);
+    perStep = timePerIteration([&](long iterations) {
+        for (long i = 0; i < iterations; i++) dopri.step(1e300);
+        sink = dopri.state()[0];
+    });
+    record("integrators", {{"method", jsonString("dopri5")},
+                           {"steps_per_second", jsonNumber(1.0 / perStep)},
+                           {"ns_per_step", jsonNumber(perStep * 1e9)}});
+}
+
+static void benchEnsemble(const Config& base, const std::vector<size_t>& sizes) {
+    std::cout << "Ensemble integration, one thread" << std::endl;
+
+    for (SimdLevel level : supportedLevels()) {
+        Config cfg = base;
+        cfg.simd = simdLevelName(level);
+        for (size_t n : sizes) {
+            PendulumEnsemble ensemble(cfg);
+            fillEnsemble(ensemble, n);
+
+            double perStep = timePerIteration([&](long iterations) {
+                ensemble.advance(static_cast<int>(iterations));
+                sink = ensemble.getTheta1(0);
+            });
+            record("ensemble", {{"simd", jsonString(cfg.simd)},
+                                {"members", jsonNumber(n)},
+                                {"member_steps_per_second", jsonNumber(n / perStep)}});
+        }
+    }
+}
+
+static void benchThreadScaling(const Config& cfg, size_t members) {
+    std::cout << "Ensemble thread scaling (" << members << " members, SIMD="
+              << simdLevelName(detectSimdLevel()) << ")" << std::endl;
+
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < hardware; threads *= 2) counts.push_back(threads);
+    counts.push_back(hardware);
+
+    PendulumEnsemble ensemble(cfg);
+    fillEnsemble(ensemble, members);
+
+    double single = 0.0;
+    for (unsigned threads : counts) {
+        ThreadPool pool(threads);
+        double perStep = timePerIteration([&](long iterations) {
+            ensemble.advance(static_cast<int>(iterations), pool);
+            sink = ensemble.getTheta1(0);
+        });
+        double rate = members / perStep;
+        if (threads == 1) single = rate;
+        record("thread_scaling", {{"threads", jsonNumber(threads)},
+                                  {"member_steps_per_second", jsonNumber(rate)},
+                                  {"speedup", jsonNumber(rate / single)}});
+    }
+}
+
+static long fileSize(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    return file ? static_cast<long>(file.tellg()) : 0;
+}
+
+static void benchWriters(const Config& base, size_t count) {
+    std::cout << "Output writers (" << count << " samples)" << std::endl;
+
+    // Samples of a real trajectory, so text formatting sees realistic digits
+    std::vector<Sample> samples(count);
+    {
+        VerletStepper<> stepper(base);
+        PendulumState state = {base.theta1, base.theta2, base.omega1, base.omega2, base.theta1, base.theta2};
+        stepper.start(state);
+        for (size_t i = 0; i < count; i++) {
+            for (int k = 0; k < 10; k++) stepper.step(state);
+            double x1 = base.L1 * sin(state.theta1), y1 = -base.L1 * cos(state.theta1);
+            samples[i] = Sample{i * 10 * base.dt, x1, y1, x1 + base.L2 * sin(state.theta2),
+                                y1 - base.L2 * cos(state.theta2), state.theta1, state.theta2, 0.0, 0.0};
+        }
+    }
+
+    const std::string positions = "bench_positions.tmp";
+    const std::string angles = "bench_angles.tmp";
+
+    struct Case {
+        const char* name;
+        std::function<long()> run;   // writes all samples, returns bytes written
+    };
+
+    Config shortest = base;
+    Config fixed6 = base;
+    fixed6.precision = 6;
+
+    std::vector<Case> cases = {
+        {"text", [&]() {
+             TextTrajectoryWriter writer;
+             writer.open(positions, angles, shortest);
+             writer.write(samples.data(), samples.size());
+             writer.close();
+             return fileSize(positions) + fileSize(angles);
+         }},
+        {"text_precision6", [&]() {
+             TextTrajectoryWriter writer;
+             writer.open(positions, angles, fixed6);
+             writer.write(samples.data(), samples.size());
+             writer.close();
+             return fileSize(positions) + fileSize(angles);
+         }},
+        {"text_async", [&]() {
+             TextTrajectoryWriter writer;
+             writer.open(positions, angles, shortest);
+             AsyncTrajectoryWriter output(writer);
+             for (const Sample& sample : samples) output.append(sample);
+             output.close();
+             writer.close();
+             return fileSize(positions) + fileSize(angles);
+         }},
+        {"binary", [&]() {
+             BinaryTrajectoryWriter writer;
+             writer.open(positions, base);
+             writer.write(samples.data(), samples.size());
+             writer.close();
+             return fileSize(positions);
+         }},
+    };
+
+    for (const Case& c : cases) {
+        long bytes = 0;
+        double perRun = timePerIteration([&](long iterations) {
+            for (long i = 0; i < iterations; i++) bytes = c.run();
+        });
+        record("writers", {{"writer", jsonString(c.name)},
+                           {"bytes", jsonNumber(bytes)},
+                           {"bytes_per_second", jsonNumber(bytes / perRun)},
+                           {"samples_per_second", jsonNumber(count / perRun)}});
+    }
+
+    std::remove(positions.c_str());
+    std::remove(angles.c_str());
+}
+
+static bool writeJson(const std::string& filename) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cerr << "Cannot create results file: " << filename << std::endl;
+        return false;
+    }
+
+    char timestamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    out << "{\n";
+    out << "  \"timestamp\": " << jsonString(timestamp) << ",\n";
+    out << "  \"compiler\": " << jsonString(__VERSION__) << ",\n";
+    out << "  \"simd\": " << jsonString(simdLevelName(detectSimdLevel())) << ",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"min_seconds\": " << jsonNumber(MIN_SECONDS);
+
+    // Results keep the order they were measured in, grouped by array
+    std::vector<std::string> groups;
+    for (const Measurement& m : results) {
+        if (std::find(groups.begin(), groups.end(), m.group) == groups.end()) groups.push_back(m.group);
+    }
+    for (const std::string& group : groups) {
+        out << ",\n  " << jsonString(group) << ": [";
+        bool first = true;
+        for (const Measurement& m : results) {
+            if (m.group != group) continue;
+            out << (first ? "\n" : ",\n") << "    {";
+            for (size_t i = 0; i < m.fields.size(); i++) {
+                out << (i ? ", " : "") << jsonString(m.fields[i].first) << ": " << m.fields[i].second;
+            }
+            out << "}";
+            first = false;
+        }
+        out << "\n  ]";
+    }
+    out << "\n}\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string resultsFile = "bench_results.json";
+    bool quick = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        } else {
+            resultsFile = arg;
+        }
+    }
+    if (quick) MIN_SECONDS /= 10;
+
+    try {
+        Config cfg = benchConfig();
+
+        benchAcceleration(cfg);
+        benchIntegrators(cfg);
+        benchEnsemble(cfg, quick ? std::vector<size_t>{512, 8192} : std::vector<size_t>{512, 8192, 131072});
+        benchThreadScaling(cfg, quick ? 8192 : 131072);
+        benchWriters(cfg, quick ? 20000 : 200000);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!writeJson(resultsFile)) return 1;
+    std::cout << "Results saved to: " << resultsFile << std::endl;
+    return 0;
+}
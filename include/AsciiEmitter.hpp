@@ -0,0 +1,98 @@
+#ifndef ASCII_EMITTER_HPP
+#define ASCII_EMITTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Buffered text output without iostreams.
+ *
+ * Numbers are formatted straight into a large reusable buffer and the buffer
+ * goes to the file with one write() system call whenever it fills up. With
+ * precision 0 doubles use the shortest representation that reads back to the
+ * same value (std::to_chars, a Ryu implementation in libstdc++), so text
+ * output is lossless; precision N gives N significant digits like printf %g.
+ */
+class AsciiEmitter {
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_t used;
+    int precision;
+    uint64_t bytesWritten;
+    bool failed;
+
+    // Longest text produced by put(double)
+    static const size_t MAX_NUMBER_CHARS = 32;
+
+    void ensureSpace(size_t n) {
+        if (used + n > buffer.size()) flush();
+    }
+
+    void writeAll(const char* data, size_t length);
+
+public:
+    static const size_t DEFAULT_BUFFER_BYTES = 1 << 20;
+
+    AsciiEmitter();
+    ~AsciiEmitter();
+
+    AsciiEmitter(const AsciiEmitter&) = delete;
+    AsciiEmitter& operator=(const AsciiEmitter&) = delete;
+
+    // Create or truncate the file, false on failure
+    bool open(const std::string& filename, size_t bufferBytes = DEFAULT_BUFFER_BYTES);
+
+    // Open an existing file cut back to its first offset bytes and continue
+    // writing after them (resuming from a checkpoint), false on failure
+    bool openAt(const std::string& filename, uint64_t offset, size_t bufferBytes = DEFAULT_BUFFER_BYTES);
+    bool isOpen() const { return fd >= 0; }
+
+    // Significant digits for put(double); 0 = shortest round-trip. More
+    // than 17 digits never adds information to a double
+    void setPrecision(int digits) { precision = digits < 0 ? 0 : (digits > 17 ? 17 : digits); }
+
+    // Format v into out, returns the end of the text (no terminator)
+    static char* formatDouble(char* out, double v, int precision);
+
+    void put(double v) {
+        ensureSpace(MAX_NUMBER_CHARS);
+        used = formatDouble(buffer.data() + used, v, precision) - buffer.data();
+    }
+
+    void put(char c) {
+        ensureSpace(1);
+        buffer[used++] = c;
+    }
+
+    void put(const char* text, size_t length) {
+        if (length > buffer.size()) {
+            flush();
+            writeAll(text, length);
+            return;
+        }
+        ensureSpace(length);
+        std::memcpy(buffer.data() + used, text, length);
+        used += length;
+    }
+
+    void put(const std::string& text) { put(text.data(), text.size()); }
+
+    // Write the buffered text with a single write() call
+    void flush();
+
+    // Flush and wait until the data is on disk
+    void sync();
+
+    // Flush and close the file; false when any write failed
+    bool close();
+
+    // Bytes handed to the operating system so far, i.e. the file length
+    // after flush()
+    uint64_t getBytesWritten() const { return bytesWritten; }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+#include <string>
+
+struct Config;
+
+/*
+ * Checkpoint File
+ * ===============
+ *
+ * Everything a trajectory run needs to continue bit-exactly, written every
+ * CHECKPOINT_EVERY steps to the CHECKPOINT file (one 512 byte record, little
+ * endian, replaced atomically through a temporary file and rename()):
+ *
+ *   integrator   step count, time, angles and angular velocities, the angles
+ *                one step back, integrator internals (canonical momenta of
+ *                the composition methods, step size and first stage of
+ *                dopri5) and clamp counters
+ *   output       position in the OUTPUT_MODE schedule and the length of the
+ *                output files: bytes of the position and angle text files,
+ *                or samples in the binary file
+ *   energy       running statistics of ENERGY=stats/columns
+ *   layout       OUTPUT_FORMAT, OUTPUT_MODE with its OUTPUT_EVERY/INTERVAL/
+ *                SAMPLES/ARC parameters, PRECISION and ENERGY, which fix the
+ *                rows already in the output files
+ *
+ * Output is drained and synced to disk before the record is written, so the
+ * files always hold at least what the checkpoint says; --resume truncates
+ * them to that length and appends. The physics parameters, METHOD and the
+ * layout keys must be unchanged, or the appended rows would not continue the
+ * ones on disk.
+ */
+struct Checkpoint {
+    char magic[8];            // "DPCKPT\0\0"
+    uint32_t version;
+    uint32_t reserved0;
+    double config[11];        // L1 L2 M1 M2 G THETA1 THETA2 OMEGA1 OMEGA2 DT TOTAL_TIME
+    char method[16];          // METHOD, NUL padded
+    char outputFormat[8];     // OUTPUT_FORMAT, NUL padded
+    char outputMode[16];      // OUTPUT_MODE, NUL padded
+    char energyMode[8];       // ENERGY, NUL padded
+    int32_t precision;        // PRECISION
+    int32_t outputEvery;      // OUTPUT_EVERY
+    int32_t outputSamples;    // OUTPUT_SAMPLES
+    uint32_t reserved1;
+    double outputInterval;    // OUTPUT_INTERVAL
+    double outputArc;         // OUTPUT_ARC
+
+    int64_t step;             // steps done (fixed step) or accepted steps (dopri5)
+    int64_t rejected;         // rejected dopri5 steps
+    double time;
+    double state[6];          // theta1 theta2 omega1 omega2 theta1_old theta2_old
+    double stepper[12];       // integrator internals, see Stepper::save
+    int64_t clamps[2];        // denominator, acceleration
+
+    int64_t scheduleIndex;    // OutputScheduler: next time-based sample
+    double travelled;         // OutputScheduler: path length since the last sample
+    int64_t sampleIndex;      // next dense output sample (dopri5)
+    uint64_t output[2];       // text: bytes in both files; binary: samples
+
+    int64_t energyCount;
+    double energy[4];         // initial, minimum, maximum, last
+
+    char reserved[64];
+};
+
+static_assert(sizeof(Checkpoint) == 512, "Checkpoint must stay 512 bytes");
+
+static const char CHECKPOINT_MAGIC[8] = {'D', 'P', 'C', 'K', 'P', 'T', '\0', '\0'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+// Empty record for this configuration: magic, parameters, METHOD and the
+// output layout keys set, everything else zero
+Checkpoint newCheckpoint(const Config& config);
+
+// Write to filename + ".tmp", sync and rename over filename, so a crash
+// leaves either the old or the new checkpoint; false on failure
+bool writeCheckpoint(const std::string& filename, const Checkpoint& checkpoint);
+
+// Read and check against the configuration; throws std::runtime_error when
+// the file is missing, damaged or was written for other parameters, METHOD
+// or output layout
+Checkpoint readCheckpoint(const std::string& filename, const Config& config);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef DORMAND_PRINCE_HPP
+#define DORMAND_PRINCE_HPP
+
+#include "DoublePendulum.hpp"
+#include "Checkpoint.hpp"
+
+/*
+ * Adaptive Dormand-Prince 5(4) Integrator
+ * =======================================
+ *
+ * Integrates y = (theta1, theta2, omega1, omega2) with
+ *   $\dot\theta_i = \omega_i, \quad \dot\omega_i = \alpha_i(\theta, \omega)$
+ * where $\alpha_i$ comes from DoublePendulum::accelerationKernel.
+ *
+ * Each step evaluates seven stages (the last one is reused as the first
+ * stage of the next step) and compares the 5th order solution with the
+ * embedded 4th order one. The step is accepted when
+ *   $\sqrt{\frac{1}{4}\sum_i \left(\frac{e_i}{atol + rtol\max(|y_i|, |\tilde y_i|)}\right)^2} \le 1$
+ * and the next step size is scaled by $0.9\,err^{-1/5}$, limited to [0.2, 5].
+ *
+ * Dense output uses the 4th order continuous extension of Hairer & Wanner,
+ * so the state can be read at any time inside the last accepted step.
+ */
+class DormandPrince {
+private:
+    Config config;
+    KernelCoefficients params;
+    double atol, rtol;
+
+    double t, h;          // current time and next step size
+    double tPrev;         // start of the last accepted step
+    double y[4];          // state at t (angles are not normalized)
+    double k1[4];         // derivative at t (first stage of the next step)
+    double cont[5][4];    // dense output coefficients of the last step
+
+    long accepted, rejected;
+    ClampCounters clampCounters;
+
+    void derivatives(const double state[4], double dydt[4]);
+
+public:
+    // Tolerances come from ATOL/RTOL, the first trial step from DT
+    DormandPrince(const Config& cfg);
+
+    // Start from a state at time t0
+    void reset(double t0, const double state[4]);
+
+    // Advance by one accepted step, never past tEnd
+    void step(double tEnd);
+
+    double time() const { return t; }
+    double previousTime() const { return tPrev; }
+    double stepSize() const { return h; }
+    const double* state() const { return y; }
+
+    // State at tau in [previousTime(), time()]
+    void interpolate(double tau, double out[4]) const;
+
+    // Time, state, step size, first stage and counters; after restore() the
+    // next step() continues bit-exactly (dense output needs a step first)
+    void save(Checkpoint& checkpoint) const;
+    void restore(const Checkpoint& checkpoint);
+
+    long acceptedSteps() const { return accepted; }
+    long rejectedSteps() const { return rejected; }
+
+    // Clamp events of accelerationKernel, rejected stages included
+    const ClampCounters& clamps() const { return clampCounters; }
+};
+
+#endif
@@ -4,6 +4,15 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <algorithm>
+#include "Profiler.hpp"
+#include "Checkpoint.hpp"
+
+// Initial-condition key given as a range (linspace/logspace) and its values
+struct SweepAxis {
+    std::string key;             // THETA1, THETA2, OMEGA1 or OMEGA2
+    std::vector<double> values;
+};
 
 struct Config {
     double L1, L2;       // Pendulum lengths
@@ -13,6 +22,37 @@ struct Config {
     double omega1, omega2;   // Initial angular velocities
     double dt;           // Time step
     double totalTime;    // Total simulation time
+
+    // Run options (optional keys, defaults apply when absent)
+    std::string method = "verlet";   // Integrator: verlet, forest-ruth, yoshida4/6/8 or dopri5
+    double atol = 1e-9;          // dopri5 absolute tolerance
+    double rtol = 1e-9;          // dopri5 relative tolerance
+    std::string simd = "auto";   // Ensemble kernel: auto, scalar, sse2, avx2, avx512
+    std::string outputFormat = "text";   // text (two ASCII files) or binary (one columnar file)
+    int precision = 0;           // Text output significant digits, 0 = shortest round-trip
+    std::string outputMode = "steps";   // Sampling: steps, interval, count or adaptive
+    int outputEvery = 100;       // steps: steps between samples
+    double outputInterval = 0.0; // interval: simulated seconds between samples
+    int outputSamples = 0;       // count: samples over the whole run
+    double outputArc = 0.0;      // adaptive: path length (m) of the outer bob between samples
+    std::string profileOutput;   // JSON file for the profile (make PROFILE=1 builds)
+    std::string onClamp = "continue";   // After CLAMP_LIMIT clamp events: continue, stop or abort
+    long clampLimit = 0;         // Clamp events tolerated before ON_CLAMP applies
+    int threads = 0;             // Sweep worker threads, 0 = all hardware threads
+    std::string sweepOutput = "final";   // Sweep result: final (states) or flip-time (image)
+    std::string lyapunov = "off";        // Lyapunov analysis: off, largest or spectrum
+    double lyapunovSeparation = 1e-8;    // Initial distance of the shadow trajectory
+    double lyapunovInterval = 0.1;       // Simulated seconds between renormalizations
+    std::string poincare = "off";        // Poincare section on: off, theta1 or theta2
+    double poincareAngle = 0.0;          // Section angle (rad)
+    std::string poincareDirection = "positive";   // Crossings kept: positive, negative or both
+    std::string energy = "off";          // Energy monitor: off, stats or columns
+    std::string checkpoint;              // Checkpoint file, empty = no checkpoints
+    long checkpointEvery = 1000000;      // Steps (accepted steps for dopri5) between checkpoints
+
+    // Initial conditions given as ranges, in file order; non-empty turns the
+    // run into a parameter sweep over their Cartesian product
+    std::vector<SweepAxis> sweep;
 };
 
 struct Point {
@@ -20,20 +60,300 @@ struct Point {
     Point(double x = 0, double y = 0) : x(x), y(y) {}
 };
 
+// One output record: positions of both balls and both angles at time t
+struct Sample {
+    double t;
+    double x1, y1, x2, y2;
+    double theta1, theta2;
+    double kinetic, potential;   // filled with ENERGY=columns only
+};
+
+// Numerical safeguards hit by one accelerationKernel evaluation (bit flags)
+enum ClampFlags {
+    CLAMP_DENOMINATOR = 1,    // |denominator| < MIN_DENOM was nudged away from zero
+    CLAMP_ACCELERATION = 2    // |alpha| > MAX_ACCEL was clamped
+};
+
+// Evaluations that hit each safeguard. Once either fires the trajectory no
+// longer follows the equations of motion, so these mark an invalid run.
+// One evaluation adds events(flags) to total(), one per safeguard it hit
+struct ClampCounters {
+    long denominator = 0;
+    long acceleration = 0;
+
+    void add(unsigned flags) {
+        denominator += (flags & CLAMP_DENOMINATOR) != 0;
+        acceleration += (flags & CLAMP_ACCELERATION) != 0;
+    }
+    void add(const ClampCounters& other) {
+        denominator += other.denominator;
+        acceleration += other.acceleration;
+    }
+    long total() const { return denominator + acceleration; }
+
+    static int events(unsigned flags) {
+        return ((flags & CLAMP_DENOMINATOR) != 0) + ((flags & CLAMP_ACCELERATION) != 0);
+    }
+};
+
+// What a run does once more than CLAMP_LIMIT clamp events occurred (ON_CLAMP)
+enum ClampPolicy {
+    CLAMP_CONTINUE,   // keep going, only report the counts
+    CLAMP_STOP,       // mark the run (ensemble member) diverged and stop it
+    CLAMP_ABORT       // throw std::runtime_error
+};
+
+/*
+ * Kernel Parameters
+ * =================
+ *
+ * accelerationKernel reads the physical constants through a parameter
+ * policy, so each invariant is computed once instead of on every call:
+ *
+ *   totalL1 = $(m_1+m_2) L_1$    totalG = $(m_1+m_2) g$    lengthRatio = $L_2 / L_1$
+ *   m2L1 = $m_2 L_1$             m2L2 = $m_2 L_2$          m2G = $m_2 g$
+ *
+ * PendulumCoefficients holds them at run time; each is the product the
+ * original formula forms first, so results are bit-identical to it.
+ *
+ * EqualPendulumCoefficients is the common case $L_1 = L_2 = L$,
+ * $m_1 = m_2 = m$. Numerator and denominators share the factor $m L$, which
+ * cancels and leaves compile-time constants 1 and 2 for every mass and
+ * length coefficient; only $g / L$ stays a run-time value. The compiler
+ * then drops the unit multiplies and, with lengthRatio = 1, the second
+ * denominator. For $m = L = 1$ the results equal the generic ones bit for
+ * bit, otherwise they differ in the last bits from the cancelled factor.
+ *
+ * Because the two round differently, the policy for a configuration is
+ * chosen in one place, KernelCoefficients, and every integrator (single
+ * run, ensemble, dopri5, Lyapunov, Poincaré) evaluates the kernel through
+ * it; a state then evolves the same bit for bit whichever of them
+ * advances it.
+ */
+struct PendulumCoefficients {
+    double totalL1, totalG;
+    double m2L1, m2L2, m2G;
+    double lengthRatio;
+
+    explicit PendulumCoefficients(const Config& cfg)
+        : totalL1((cfg.M1 + cfg.M2) * cfg.L1), totalG((cfg.M1 + cfg.M2) * cfg.G),
+          m2L1(cfg.M2 * cfg.L1), m2L2(cfg.M2 * cfg.L2), m2G(cfg.M2 * cfg.G),
+          lengthRatio(cfg.L2 / cfg.L1) {}
+};
+
+struct EqualPendulumCoefficients {
+    static constexpr double totalL1 = 2.0;
+    static constexpr double m2L1 = 1.0;
+    static constexpr double m2L2 = 1.0;
+    static constexpr double lengthRatio = 1.0;
+    double m2G;      // g / L
+    double totalG;   // 2 g / L
+
+    explicit EqualPendulumCoefficients(const Config& cfg)
+        : m2G(cfg.G / cfg.L1), totalG(2.0 * (cfg.G / cfg.L1)) {}
+
+    // Equal arms and masses; m L must stay above MIN_DENOM, below it the
+    // generic kernel would clamp a denominator this one never clamps
+    static bool applies(const Config& cfg, double minDenominator) {
+        return cfg.L1 == cfg.L2 && cfg.M1 == cfg.M2 && cfg.M1 * cfg.L1 >= minDenominator;
+    }
+};
+
+// The parameter policy of accelerationKernel for a configuration: both
+// policies and which one applies. select(f) calls f with the chosen one;
+// loops call it outside, so inside them the policy is a compile-time type
+struct KernelCoefficients {
+    PendulumCoefficients general;
+    EqualPendulumCoefficients equal;
+    bool equalParameters;    // EqualPendulumCoefficients::applies
+
+    explicit KernelCoefficients(const Config& cfg);
+
+    template <typename F>
+    decltype(auto) select(F&& f) const {
+        if (equalParameters) {
+            return f(equal);
+        }
+        return f(general);
+    }
+};
+
+// sin and cos of one angle from a single argument reduction (glibc sincos)
+inline void fusedSinCos(double x, double& s, double& c) {
+#ifdef __GLIBC__
+    ::sincos(x, &s, &c);
+#else
+    s = std::sin(x);
+    c = std::cos(x);
+#endif
+}
+
+/*
+ * Pendulum Trigonometry
+ * =====================
+ *
+ * Every transcendental the equations of motion, the ball positions and the
+ * energy need, from two fused sincos evaluations. With
+ * $\delta = \theta_2 - \theta_1$ the difference terms follow from the
+ * angle-addition identities
+ *   $\sin\delta = \sin\theta_2\cos\theta_1 - \cos\theta_2\sin\theta_1$
+ *   $\cos\delta = \cos\theta_2\cos\theta_1 + \sin\theta_2\sin\theta_1$
+ * instead of a third argument reduction. They are not rounded like a direct
+ * $\sin(\theta_2-\theta_1)$ and differ from it by a few ulp, so trajectories
+ * differ at round-off level from ones computed that way (about 1e-12 after
+ * 10 s at DT=1e-4 from the default initial conditions); that is far below
+ * the error of any integrator here, but not bit-identical.
+ */
+struct PendulumTrig {
+    double sin1, cos1;
+    double sin2, cos2;
+    double sinDelta, cosDelta;   // of theta2 - theta1
+
+    PendulumTrig() = default;
+    PendulumTrig(double theta1, double theta2) {
+        fusedSinCos(theta1, sin1, cos1);
+        fusedSinCos(theta2, sin2, cos2);
+        sinDelta = sin2 * cos1 - cos2 * sin1;
+        cosDelta = cos2 * cos1 + sin2 * sin1;
+    }
+};
+
+class TrajectoryWriter;
+class AsyncTrajectoryWriter;
+class OutputScheduler;
+class Stepper;
+class EnergyMonitor;
+
 class DoublePendulum {
 private:
+    // Invariants of the configuration for calculateAcceleration and
+    // verletStep, computed once in the constructor so a step reads them from
+    // one block instead of recomputing them from config
+    struct CoefficientCache {
+        KernelCoefficients kernel;   // the policy every integrator uses
+        double dt, twoDt;
+
+        explicit CoefficientCache(const Config& cfg);
+    };
+    
     Config config;
+    CoefficientCache cache;
     double theta1, theta2;
     double omega1, omega2;
     double theta1_old, theta2_old;
     double omega1_old, omega2_old;
+    ClampCounters clamps;
+    ClampPolicy clampPolicy;
+    bool energyColumns;
     
-    // Normalize angle to [-π, π] range
-    double normalizeAngle(double angle);
+    // What the last run left for the console report of runSimulation
+    std::string divergence;      // ON_CLAMP=stop: why the run stopped, empty otherwise
+    double stopTime;             // ON_CLAMP=stop: time the run stopped at
+    long acceptedSteps, rejectedSteps;   // dopri5 steps
+    
+    // Set by resumeFromCheckpoint(): the next run continues from restart
+    Checkpoint restart;
+    bool resuming;
+    
+    // simulate() into the writer for the simulateAndOutput* functions;
+    // samples are handed to it from a separate output thread. Prints the
+    // progress and the summary of the run to std::cout
+    void runSimulation(TrajectoryWriter& writer);
+    
+    // The loop behind simulate() and runSimulation, defined in
+    // SimulationLoop.hpp; energy, when not null, is fed the total energy
+    // after every step
+    template <typename Sink>
+    void integrate(Sink& sink, EnergyMonitor* energy);
+    
+    // Integrator-specific parts of integrate() (METHOD key)
+    template <typename Sink>
+    void integrateFixedStep(Stepper& stepper, OutputScheduler& schedule, Sink& sink, EnergyMonitor* energy);
+    template <typename Sink>
+    void integrateDormandPrince(OutputScheduler& schedule, Sink& sink, EnergyMonitor* energy);
+    
+    // Complete a checkpoint whose integrator part is filled in: output
+    // position and energy statistics, then write the CHECKPOINT file
+    void saveCheckpoint(Checkpoint& checkpoint, OutputScheduler& schedule, AsyncTrajectoryWriter& output,
+                        EnergyMonitor* energy);
+    
+    // Sample of the current state at time t; with ENERGY=columns it carries
+    // the energy of the angles and angular velocities. Positions come from
+    // trig, the PendulumTrig of theta1 and theta2, the energy from
+    // energyTrig, that of the angles the velocities belong to
+    Sample currentSample(double t, const PendulumTrig& trig, const PendulumTrig& energyTrig);
+    Sample currentSample(double t) {
+        const PendulumTrig trig(theta1, theta2);
+        return currentSample(t, trig, trig);
+    }
+    
+    // ON_CLAMP once a run has more than CLAMP_LIMIT clamp events: true when
+    // the run stops here (stop), throws std::runtime_error for abort
+    bool exceedsClampLimit(const ClampCounters& counters, double t);
+    
+    // Steps of a fixed-step run, the first being the initial state
+    int fixedStepCount() const { return static_cast<int>(config.totalTime / config.dt); }
     
 public:
+    // Throws std::invalid_argument for an unknown ON_CLAMP or ENERGY, for
+    // ENERGY=columns with binary output or a non-positive CHECKPOINT_EVERY
     DoublePendulum(const Config& cfg);
     
+    // Make the next simulateAndOutput* call continue from the CHECKPOINT
+    // file and append to the output files of the interrupted run. Throws
+    // std::invalid_argument without CHECKPOINT, std::runtime_error when the
+    // checkpoint cannot be used
+    void resumeFromCheckpoint();
+    
+    // Normalize angle to [-π, π] range
+    static double normalizeAngle(double angle);
+    
+    // Normalize theta and move thetaOld, the same angle one step earlier, by
+    // the same multiple of 2π, so their difference (the velocity of a
+    // two-step method) does not jump when an arm goes over the top
+    static void wrapAngle(double& theta, double& thetaOld);
+    
+    // Limits of the safeguards in accelerationKernel
+    static constexpr double MIN_DENOM = 1e-10;
+    static constexpr double MAX_ACCEL = 1000.0;
+    
+    // Parse ON_CLAMP: continue, stop or abort; throws std::invalid_argument
+    static ClampPolicy parseClampPolicy(const std::string& name);
+    
+    // Angular accelerations for an arbitrary state; shared by DoublePendulum
+    // and PendulumEnsemble so both integrate exactly the same equations.
+    // Returns the ClampFlags of the safeguards that fired
+    static inline unsigned accelerationKernel(const Config& cfg,
+                                          double theta1, double theta2,
+                                          double omega1, double omega2,
+                                          double& alpha1, double& alpha2);
+    
+    // The same with the policy KernelCoefficients selected, for objects that
+    // keep one across calls
+    static inline unsigned accelerationKernel(const KernelCoefficients& params,
+                                              double theta1, double theta2,
+                                              double omega1, double omega2,
+                                              double& alpha1, double& alpha2);
+    static inline unsigned accelerationKernel(const KernelCoefficients& params, const PendulumTrig& trig,
+                                              double omega1, double omega2,
+                                              double& alpha1, double& alpha2);
+    
+    // The same with the constants from a parameter policy
+    // (PendulumCoefficients or EqualPendulumCoefficients); loops select the
+    // policy outside and call this
+    template <typename Params>
+    static inline unsigned accelerationKernel(const Params& params,
+                                              double theta1, double theta2,
+                                              double omega1, double omega2,
+                                              double& alpha1, double& alpha2);
+    
+    // The same from the PendulumTrig of the angles, for callers that reuse
+    // it for positions or energy
+    template <typename Params>
+    static inline unsigned accelerationKernel(const Params& params, const PendulumTrig& trig,
+                                              double omega1, double omega2,
+                                              double& alpha1, double& alpha2);
+    
     // Load configuration file
     static Config loadConfig(const std::string& filename);
     
@@ -43,12 +363,21 @@ public:
     // Calculate acceleration
     void calculateAcceleration(double& alpha1, double& alpha2);
     
+    // Run the simulation and call sink(const Sample&) with every sample on
+    // this thread as it is produced, without any file or console output.
+    // Defined in SimulationLoop.hpp; include it to use this
+    template <typename Sink>
+    void simulate(Sink&& sink);
+    
     // Run simulation and output data to file
     void simulateAndOutputData(const std::string& dataFilename);
     
     // Run simulation and output both position and angle data
     void simulateAndOutputAllData(const std::string& positionFilename, const std::string& angleFilename);
     
+    // Run simulation and output positions and angles to one binary columnar file
+    void simulateAndOutputBinaryData(const std::string& dataFilename);
+    
     // Get ball positions
     Point getPendulum1Position();
     Point getPendulum2Position();
@@ -56,6 +385,90 @@ public:
     // Get current angles
     double getTheta1() const { return theta1; }
     double getTheta2() const { return theta2; }
+    
+    // Clamp events so far, and whether ON_CLAMP=stop ended the last run
+    const ClampCounters& getClampCounters() const { return clamps; }
+    bool isDiverged() const { return !divergence.empty(); }
 };
 
+inline KernelCoefficients::KernelCoefficients(const Config& cfg)
+    : general(cfg), equal(cfg),
+      equalParameters(EqualPendulumCoefficients::applies(cfg, DoublePendulum::MIN_DENOM)) {}
+
+inline unsigned DoublePendulum::accelerationKernel(const Config& cfg,
+                                               double theta1, double theta2,
+                                               double omega1, double omega2,
+                                               double& alpha1, double& alpha2) {
+    return accelerationKernel(KernelCoefficients(cfg), theta1, theta2, omega1, omega2, alpha1, alpha2);
+}
+
+inline unsigned DoublePendulum::accelerationKernel(const KernelCoefficients& params,
+                                                   double theta1, double theta2,
+                                                   double omega1, double omega2,
+                                                   double& alpha1, double& alpha2) {
+    return accelerationKernel(params, PendulumTrig(theta1, theta2), omega1, omega2, alpha1, alpha2);
+}
+
+inline unsigned DoublePendulum::accelerationKernel(const KernelCoefficients& params, const PendulumTrig& trig,
+                                                   double omega1, double omega2,
+                                                   double& alpha1, double& alpha2) {
+    return params.select([&](const auto& policy) {
+        return accelerationKernel(policy, trig, omega1, omega2, alpha1, alpha2);
+    });
+}
+
+template <typename Params>
+inline unsigned DoublePendulum::accelerationKernel(const Params& params,
+                                                   double theta1, double theta2,
+                                                   double omega1, double omega2,
+                                                   double& alpha1, double& alpha2) {
+    return accelerationKernel(params, PendulumTrig(theta1, theta2), omega1, omega2, alpha1, alpha2);
+}
+
+template <typename Params>
+inline unsigned DoublePendulum::accelerationKernel(const Params& params, const PendulumTrig& trig,
+                                                   double omega1, double omega2,
+                                                   double& alpha1, double& alpha2) {
+    const double cos_delta = trig.cosDelta;
+    const double sin_delta = trig.sinDelta;
+    
+    double denom1 = params.totalL1 - params.m2L1 * cos_delta * cos_delta;
+    double denom2 = params.lengthRatio * denom1;
+    
+    // Check for numerical stability - prevent division by very small numbers
+    unsigned clamped = 0;
+    if (std::abs(denom1) < MIN_DENOM) {
+        // Use a small but non-zero value to prevent explosion
+        denom1 = (denom1 >= 0) ? MIN_DENOM : -MIN_DENOM;
+        clamped |= CLAMP_DENOMINATOR;
+    }
+    if (std::abs(denom2) < MIN_DENOM) {
+        denom2 = (denom2 >= 0) ? MIN_DENOM : -MIN_DENOM;
+        clamped |= CLAMP_DENOMINATOR;
+    }
+    
+    // Calculate angular acceleration of first pendulum
+    alpha1 = (params.m2L1 * omega1 * omega1 * sin_delta * cos_delta
+              + params.m2G * trig.sin2 * cos_delta
+              + params.m2L2 * omega2 * omega2 * sin_delta
+              - params.totalG * trig.sin1) / denom1;
+    
+    // Calculate angular acceleration of second pendulum
+    alpha2 = (-params.m2L2 * omega2 * omega2 * sin_delta * cos_delta
+              + params.totalG * trig.sin1 * cos_delta
+              - params.totalL1 * omega1 * omega1 * sin_delta
+              - params.totalG * trig.sin2) / denom2;
+    
+    // Clamp accelerations to prevent runaway values (MAX_ACCEL is a
+    // reasonable upper bound)
+    if (std::abs(alpha1) > MAX_ACCEL || std::abs(alpha2) > MAX_ACCEL) {
+        clamped |= CLAMP_ACCELERATION;
+    }
+    alpha1 = std::max(-MAX_ACCEL, std::min(MAX_ACCEL, alpha1));
+    alpha2 = std::max(-MAX_ACCEL, std::min(MAX_ACCEL, alpha2));
+    
+    DP_PROFILE_COUNT(CLAMPS, clamped != 0);
+    return clamped;
+}
+
 #endif
@@ -0,0 +1,80 @@
+#ifndef ENERGY_HPP
+#define ENERGY_HPP
+
+#include "DoublePendulum.hpp"
+#include "Checkpoint.hpp"
+#include <cmath>
+#include <ostream>
+
+/*
+ * Energy of the Double Pendulum
+ * =============================
+ *
+ *   $T = \frac{1}{2}(m_1+m_2)L_1^2\omega_1^2 + \frac{1}{2}m_2 L_2^2\omega_2^2
+ *        + m_2 L_1 L_2\omega_1\omega_2\cos(\theta_1-\theta_2)$
+ *   $V = -(m_1+m_2) g L_1\cos\theta_1 - m_2 g L_2\cos\theta_2$
+ *
+ * The total $E = T + V$ is conserved by the equations of motion, so its
+ * spread over a run measures the integration error. Angles and velocities
+ * must belong to the same instant: for METHOD=verlet, whose central
+ * difference knows the velocity one step back, E is taken at the previous
+ * angles (Stepper::velocityTrig).
+ */
+struct Energy {
+    double kinetic;
+    double potential;
+
+    double total() const { return kinetic + potential; }
+};
+
+// Energy from the cosines of both angles and of their difference
+inline Energy pendulumEnergy(const Config& cfg, double cos1, double cos2, double cosDelta,
+                             double omega1, double omega2) {
+    Energy e;
+    e.kinetic = 0.5 * (cfg.M1 + cfg.M2) * cfg.L1 * cfg.L1 * omega1 * omega1
+              + 0.5 * cfg.M2 * cfg.L2 * cfg.L2 * omega2 * omega2
+              + cfg.M2 * cfg.L1 * cfg.L2 * omega1 * omega2 * cosDelta;
+    e.potential = -(cfg.M1 + cfg.M2) * cfg.G * cfg.L1 * cos1 - cfg.M2 * cfg.G * cfg.L2 * cos2;
+    return e;
+}
+
+// Energy from the PendulumTrig of the angles, e.g. the one the
+// acceleration kernel or the ball positions already used
+inline Energy pendulumEnergy(const Config& cfg, const PendulumTrig& trig, double omega1, double omega2) {
+    return pendulumEnergy(cfg, trig.cos1, trig.cos2, trig.cosDelta, omega1, omega2);
+}
+
+inline Energy pendulumEnergy(const Config& cfg, double theta1, double theta2,
+                             double omega1, double omega2) {
+    return pendulumEnergy(cfg, PendulumTrig(theta1, theta2), omega1, omega2);
+}
+
+/*
+ * Running statistics of the total energy, fed once per integrator step
+ * (ENERGY=stats or columns). Relative figures are taken against the depth of
+ * the potential well, $(m_1+m_2) g L_1 + m_2 g L_2$, which unlike E itself
+ * is never close to zero.
+ */
+class EnergyMonitor {
+private:
+    double scale;
+    double initial, minimum, maximum, last;
+    long count;
+
+public:
+    explicit EnergyMonitor(const Config& cfg);
+
+    void add(double total);
+
+    long samples() const { return count; }
+    double drift() const { return last - initial; }
+
+    // min, max, drift and the largest deviation from the initial energy
+    void report(std::ostream& out) const;
+
+    // Running statistics, for checkpoints
+    void save(Checkpoint& checkpoint) const;
+    void restore(const Checkpoint& checkpoint);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef HAMILTONIAN_HPP
+#define HAMILTONIAN_HPP
+
+#include "DoublePendulum.hpp"
+#include <cmath>
+
+/*
+ * Canonical (Hamiltonian) Formulation
+ * ===================================
+ *
+ * State $(\theta_1, \theta_2, p_1, p_2)$ with the canonical momenta
+ *   $p_1 = (m_1+m_2)L_1^2\omega_1 + m_2 L_1 L_2\cos\Delta\,\omega_2$
+ *   $p_2 = m_2 L_2^2\omega_2 + m_2 L_1 L_2\cos\Delta\,\omega_1$
+ * where $\Delta = \theta_1 - \theta_2$. With $D = m_1 + m_2\sin^2\Delta$,
+ * Hamilton's equations have the closed form
+ *   $\dot\theta_1 = \frac{L_2 p_1 - L_1 p_2\cos\Delta}{L_1^2 L_2 D}$
+ *   $\dot\theta_2 = \frac{L_1(m_1+m_2)p_2 - L_2 m_2 p_1\cos\Delta}{L_1 L_2^2 m_2 D}$
+ *   $\dot p_1 = -(m_1+m_2) g L_1\sin\theta_1 - C_1 + C_2$
+ *   $\dot p_2 = -m_2 g L_2\sin\theta_2 + C_1 - C_2$
+ * with
+ *   $C_1 = \frac{p_1 p_2\sin\Delta}{L_1 L_2 D}$
+ *   $C_2 = \frac{(L_2^2 m_2 p_1^2 + L_1^2(m_1+m_2)p_2^2 - 2 L_1 L_2 m_2 p_1 p_2\cos\Delta)\sin 2\Delta}{2 L_1^2 L_2^2 D^2}$
+ *
+ * Unlike calculateAcceleration there is no mass-matrix system to solve:
+ * one evaluation costs a single division (1/D), and the four sines and
+ * cosines depend on the angles only, so a scheme that iterates on the
+ * momenta at fixed angles computes them once (see CanonicalTrig).
+ */
+
+// Trigonometric terms of Hamilton's equations at one configuration, taken
+// from the two fused sincos of PendulumTrig (whose delta has the other sign)
+struct CanonicalTrig {
+    double sin1, sin2;             // sin(theta1), sin(theta2)
+    double sinDelta, cosDelta;     // of theta1 - theta2
+
+    explicit CanonicalTrig(const PendulumTrig& trig)
+        : sin1(trig.sin1), sin2(trig.sin2), sinDelta(-trig.sinDelta), cosDelta(trig.cosDelta) {}
+    CanonicalTrig(double theta1, double theta2) : CanonicalTrig(PendulumTrig(theta1, theta2)) {}
+};
+
+// Momenta (p1, p2) of the angular velocities (omega1, omega2)
+inline void canonicalMomenta(const Config& cfg, const CanonicalTrig& trig,
+                             double omega1, double omega2, double& p1, double& p2) {
+    double coupling = cfg.M2 * cfg.L1 * cfg.L2 * trig.cosDelta;
+    p1 = (cfg.M1 + cfg.M2) * cfg.L1 * cfg.L1 * omega1 + coupling * omega2;
+    p2 = cfg.M2 * cfg.L2 * cfg.L2 * omega2 + coupling * omega1;
+}
+
+// Hamilton's equations: (dtheta1, dtheta2, dp1, dp2) at (theta, p); dtheta
+// are the angular velocities
+inline void hamiltonDerivatives(const Config& cfg, const CanonicalTrig& trig,
+                                double p1, double p2, double dz[4]) {
+    const double L1 = cfg.L1, L2 = cfg.L2;
+    const double M1 = cfg.M1, M2 = cfg.M2;
+
+    double D = M1 + M2 * trig.sinDelta * trig.sinDelta;
+    // The only division: every denominator below is a multiple of L1^2 L2^2 m2 D
+    double q = 1.0 / (L1 * L1 * L2 * L2 * M2 * D);
+    double invL1L2D = q * (L1 * L2 * M2);
+
+    dz[0] = (L2 * p1 - L1 * p2 * trig.cosDelta) * (q * L2 * M2);
+    dz[1] = (L1 * (M1 + M2) * p2 - L2 * M2 * p1 * trig.cosDelta) * (q * L1);
+
+    // sin(2 Delta) / 2 = sin(Delta) cos(Delta)
+    double c1 = p1 * p2 * trig.sinDelta * invL1L2D;
+    double c2 = (L2 * L2 * M2 * p1 * p1 + L1 * L1 * (M1 + M2) * p2 * p2
+                 - 2.0 * L1 * L2 * M2 * p1 * p2 * trig.cosDelta)
+                * trig.sinDelta * trig.cosDelta * invL1L2D * invL1L2D;
+
+    dz[2] = -(M1 + M2) * cfg.G * L1 * trig.sin1 - c1 + c2;
+    dz[3] = -M2 * cfg.G * L2 * trig.sin2 + c1 - c2;
+}
+
+#endif
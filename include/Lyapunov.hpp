@@ -0,0 +1,149 @@
+#ifndef LYAPUNOV_HPP
+#define LYAPUNOV_HPP
+
+#include "DoublePendulum.hpp"
+#include "Matrix4.hpp"
+#include "Stepper.hpp"
+#include <memory>
+#include <string>
+
+/*
+ * Largest Lyapunov Exponent
+ * =========================
+ *
+ * A shadow trajectory starts at distance $d_0$ (LYAPUNOV_SEPARATION) from
+ * the reference trajectory and is integrated next to it with the same
+ * METHOD. Every LYAPUNOV_INTERVAL seconds the separation $d_k$ is measured
+ * in $(\theta_1, \theta_2, \omega_1, \omega_2)$ and the shadow is pulled
+ * back along the same direction to distance $d_0$ (Benettin et al. 1980), so
+ * it never leaves the linear regime. The running estimate is
+ *   $\lambda(t_n) = \frac{1}{t_n}\sum_{k=1}^{n}\ln\frac{d_k}{d_0}$
+ *
+ * Only (time, lambda) pairs are written, one per renormalization, never the
+ * trajectories themselves.
+ */
+class LyapunovEstimator {
+private:
+    Config config;
+    std::unique_ptr<Stepper> reference, shadow;
+    PendulumState referenceState, shadowState;
+
+    double logGrowth;    // sum of ln(d_k / d_0)
+    double time;
+
+    // Separation of the shadow from the reference; angle differences are
+    // taken across the ±π seam
+    double separation() const;
+
+    // Pull the shadow back to distance d_0, returns d_k / d_0; throws
+    // std::runtime_error when the separation is no longer finite
+    double renormalize();
+
+public:
+    // Fixed-step METHOD only; throws std::invalid_argument for dopri5 or a
+    // non-positive separation or interval
+    explicit LyapunovEstimator(const Config& cfg);
+
+    // Integrate over TOTAL_TIME and write the running exponent; false when
+    // the file cannot be created
+    bool run(const std::string& filename);
+
+    // Running estimate of the largest exponent (1/s)
+    double getExponent() const { return time > 0.0 ? logGrowth / time : 0.0; }
+
+    // Clamp events of both trajectories
+    ClampCounters getClampCounters() const;
+};
+
+/*
+ * Analytic Jacobian of the accelerations of accelerationKernel. With
+ * $\delta = \theta_2 - \theta_1$ each acceleration is $\alpha = N / d$, so
+ *   $\partial\alpha / \partial x = (\partial N / \partial x - \alpha\,\partial d / \partial x) / d$
+ * where $\partial d_1 / \partial\delta = 2 m_2 L_1\sin\delta\cos\delta$ and
+ * $d_2 = (L_2 / L_1) d_1$. Row k of jac holds the partials of alpha_{k+1}
+ * with respect to (theta1, theta2, omega1, omega2). The safeguards of
+ * accelerationKernel are not differentiated; its ClampFlags are returned.
+ */
+inline unsigned accelerationJacobian(const Config& cfg,
+                                     double theta1, double theta2,
+                                     double omega1, double omega2,
+                                     double& alpha1, double& alpha2, double jac[2][4]) {
+    // One PendulumTrig for the accelerations and their partials
+    const PendulumTrig trig(theta1, theta2);
+    unsigned clamped = DoublePendulum::accelerationKernel(KernelCoefficients(cfg), trig, omega1, omega2,
+                                                          alpha1, alpha2);
+
+    const double L1 = cfg.L1, L2 = cfg.L2;
+    const double M1 = cfg.M1, M2 = cfg.M2;
+    const double g = cfg.G;
+
+    double c = trig.cosDelta, s = trig.sinDelta;
+    double sin1 = trig.sin1, cos1 = trig.cos1;
+    double sin2 = trig.sin2, cos2 = trig.cos2;
+    double cos2Delta = c * c - s * s;
+
+    double denom1 = (M1 + M2) * L1 - M2 * L1 * c * c;
+    double denom2 = (L2 / L1) * denom1;
+    double dDenom1 = 2.0 * M2 * L1 * s * c;
+    double dDenom2 = (L2 / L1) * dDenom1;
+
+    // d/d(delta) of the numerators, then of the accelerations
+    double dN1 = M2 * L1 * omega1 * omega1 * cos2Delta - M2 * g * sin2 * s + M2 * L2 * omega2 * omega2 * c;
+    double dN2 = -M2 * L2 * omega2 * omega2 * cos2Delta - (M1 + M2) * g * sin1 * s
+                 - (M1 + M2) * L1 * omega1 * omega1 * c;
+    double dAlpha1 = (dN1 - alpha1 * dDenom1) / denom1;
+    double dAlpha2 = (dN2 - alpha2 * dDenom2) / denom2;
+
+    // Explicit angle dependence, plus -/+ d/d(delta) for theta1/theta2
+    jac[0][0] = -(M1 + M2) * g * cos1 / denom1 - dAlpha1;
+    jac[0][1] = M2 * g * cos2 * c / denom1 + dAlpha1;
+    jac[1][0] = (M1 + M2) * g * cos1 * c / denom2 - dAlpha2;
+    jac[1][1] = -(M1 + M2) * g * cos2 / denom2 + dAlpha2;
+
+    jac[0][2] = 2.0 * M2 * L1 * omega1 * s * c / denom1;
+    jac[0][3] = 2.0 * M2 * L2 * omega2 * s / denom1;
+    jac[1][2] = -2.0 * (M1 + M2) * L1 * omega1 * s / denom2;
+    jac[1][3] = -2.0 * M2 * L2 * omega2 * s * c / denom2;
+    return clamped;
+}
+
+/*
+ * Lyapunov Spectrum
+ * =================
+ *
+ * All four exponents of the $(\theta_1, \theta_2, \omega_1, \omega_2)$ flow.
+ * The state and the tangent matrix $\Phi$ (columns: four tangent vectors)
+ * follow the variational equations
+ *   $\dot y = f(y), \quad \dot\Phi = J(y)\,\Phi$
+ * integrated together with classical RK4 (METHOD is not used). Every
+ * LYAPUNOV_INTERVAL seconds $\Phi = QR$ by Gram-Schmidt, $\Phi \leftarrow Q$,
+ * and $\lambda_i = \frac{1}{t}\sum\ln R_{ii}$. The first two rows of J
+ * just copy the velocity rows of $\Phi$, so each RK4 stage adds only a 2x4
+ * by 4x4 product to the accelerations.
+ */
+class LyapunovSpectrum {
+private:
+    Config config;
+    double y[4];       // theta1, theta2, omega1, omega2 (angles not wrapped)
+    Mat4 phi;
+    double logGrowth[4];
+    double time;
+    ClampCounters clamps;
+
+    // (y', Phi') at (y, Phi)
+    void derivatives(const double state[4], const Mat4& tangent, double dy[4], Mat4& dtangent);
+    void rk4Step(double h);
+
+public:
+    // Throws std::invalid_argument for a non-positive LYAPUNOV_INTERVAL
+    explicit LyapunovSpectrum(const Config& cfg);
+
+    // Integrate over TOTAL_TIME and write the running exponents; false when
+    // the file cannot be created
+    bool run(const std::string& filename);
+
+    // Running estimate of exponent i, largest first (1/s)
+    double getExponent(int i) const { return time > 0.0 ? logGrowth[i] / time : 0.0; }
+};
+
+#endif
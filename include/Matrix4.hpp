@@ -0,0 +1,72 @@
+#ifndef MATRIX4_HPP
+#define MATRIX4_HPP
+
+#include <cmath>
+
+/*
+ * Fixed-size 4x4 kernels for the variational equations. Every loop is
+ * expanded at compile time by Unroll, so a tangent-matrix update is straight
+ * line code the compiler can keep in registers.
+ */
+
+// f(0), f(1), ..., f(N - 1), expanded by template recursion
+template <int N>
+struct Unroll {
+    template <class F>
+    static inline void apply(F&& f) {
+        Unroll<N - 1>::apply(f);
+        f(N - 1);
+    }
+};
+
+template <>
+struct Unroll<0> {
+    template <class F>
+    static inline void apply(F&&) {}
+};
+
+// Row-major; the columns are the tangent vectors
+struct Mat4 {
+    double a[4][4];
+
+    static Mat4 identity() {
+        Mat4 m;
+        Unroll<4>::apply([&](int i) {
+            Unroll<4>::apply([&](int j) { m.a[i][j] = i == j ? 1.0 : 0.0; });
+        });
+        return m;
+    }
+};
+
+// y = x + h * d
+inline Mat4 addScaled(const Mat4& x, double h, const Mat4& d) {
+    Mat4 y;
+    Unroll<4>::apply([&](int i) {
+        Unroll<4>::apply([&](int j) { y.a[i][j] = x.a[i][j] + h * d.a[i][j]; });
+    });
+    return y;
+}
+
+// Dot product of columns i and j
+inline double columnDot(const Mat4& m, int i, int j) {
+    double sum = 0.0;
+    Unroll<4>::apply([&](int k) { sum += m.a[k][i] * m.a[k][j]; });
+    return sum;
+}
+
+// Modified Gram-Schmidt: m = Q R with orthonormal Q written back into m;
+// r receives the diagonal of R (the stretch of each column)
+inline void orthonormalize(Mat4& m, double r[4]) {
+    Unroll<4>::apply([&](int j) {
+        Unroll<4>::apply([&](int i) {
+            if (i >= j) return;
+            double projection = columnDot(m, i, j);
+            Unroll<4>::apply([&](int k) { m.a[k][j] -= projection * m.a[k][i]; });
+        });
+        r[j] = std::sqrt(columnDot(m, j, j));
+        double scale = 1.0 / r[j];
+        Unroll<4>::apply([&](int k) { m.a[k][j] *= scale; });
+    });
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef OUTPUT_SCHEDULER_HPP
+#define OUTPUT_SCHEDULER_HPP
+
+#include "DoublePendulum.hpp"
+#include "Checkpoint.hpp"
+#include <algorithm>
+#include <cmath>
+
+/*
+ * Decides at which integration steps a sample is written (OUTPUT_MODE key):
+ *
+ *   steps     every OUTPUT_EVERY steps (default 100, the original behaviour)
+ *   interval  every OUTPUT_INTERVAL seconds of simulated (not wall-clock) time
+ *   count     OUTPUT_SAMPLES samples spread evenly over TOTAL_TIME
+ *   adaptive  whenever the outer bob has moved OUTPUT_ARC metres along its
+ *             path, summing dt * bobSpeed() over the steps, so fast swings
+ *             get dense samples and slow phases sparse ones
+ *
+ * The first step is always sampled. Time-based modes do not depend on DT.
+ */
+class OutputScheduler {
+public:
+    enum Mode { STEPS, INTERVAL, COUNT, ADAPTIVE };
+
+private:
+    Mode mode;
+    int every;
+    double interval;
+    double arc;
+    double L1, L2, dt;
+
+    long long nextIndex;     // sample number due next (time-based modes)
+    double travelled;        // path length since the last sample (adaptive)
+
+public:
+    // Throws std::invalid_argument on an unknown mode or a non-positive setting
+    explicit OutputScheduler(const Config& cfg);
+
+    Mode getMode() const { return mode; }
+
+    // Position in the schedule, for checkpoints
+    void save(Checkpoint& checkpoint) const {
+        checkpoint.scheduleIndex = nextIndex;
+        checkpoint.travelled = travelled;
+    }
+    void restore(const Checkpoint& checkpoint) {
+        nextIndex = checkpoint.scheduleIndex;
+        travelled = checkpoint.travelled;
+    }
+
+    // Time-based scheduling (every mode except adaptive) for integrators
+    // that sample through dense output instead of landing on each step
+    bool isTimeBased() const { return mode != ADAPTIVE; }
+
+    // Nominal time of sample k (k = 0 is t = 0) in a time-based mode; in
+    // steps mode this is k * OUTPUT_EVERY * DT, the time Verlet would sample
+    double sampleTime(long long k) const {
+        return mode == STEPS ? k * (every * dt) : k * interval;
+    }
+
+    // Speed of the outer bob (m/s):
+    //   $|v_2|^2 = (L_1\omega_1)^2 + (L_2\omega_2)^2 + 2 L_1 L_2\omega_1\omega_2\cos(\theta_1 - \theta_2)$
+    double bobSpeed(double theta1, double theta2, double omega1, double omega2) const {
+        double v1 = L1 * omega1, v2 = L2 * omega2;
+        double squared = v1 * v1 + v2 * v2 + 2.0 * v1 * v2 * std::cos(theta1 - theta2);
+        return std::sqrt(std::max(0.0, squared));   // round-off can dip below 0
+    }
+
+    // Adaptive mode for variable steps: add the path length of the last
+    // step, true when a sample is due at its end
+    bool dueAfterTravel(double length) {
+        travelled += length;
+        if (travelled >= arc) {
+            travelled = 0.0;
+            return true;
+        }
+        return false;
+    }
+
+    // Call once per step with the state after step i (time t); true when a
+    // sample should be written now
+    bool due(int i, double t, double theta1, double theta2, double omega1, double omega2) {
+        if (i == 0) return true;
+
+        switch (mode) {
+            case STEPS:
+                return i % every == 0;
+            case INTERVAL:
+            case COUNT:
+                // Half a step of slack absorbs the rounding in t += dt
+                if (t + 0.5 * dt >= nextIndex * interval) {
+                    nextIndex++;
+                    return true;
+                }
+                return false;
+            case ADAPTIVE:
+                travelled += dt * bobSpeed(theta1, theta2, omega1, omega2);
+                if (travelled >= arc) {
+                    travelled = 0.0;
+                    return true;
+                }
+                return false;
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef PARAMETER_SWEEP_HPP
+#define PARAMETER_SWEEP_HPP
+
+#include "DoublePendulum.hpp"
+#include "PendulumEnsemble.hpp"
+#include "ThreadPool.hpp"
+#include <string>
+
+/*
+ * Parameter Sweep
+ * ===============
+ *
+ * Initial conditions given as ranges in the config file, e.g.
+ *
+ *   THETA1=linspace(-3.14, 3.14, 1024)
+ *   THETA2=linspace(-3.14, 3.14, 1024)
+ *
+ * expand into one PendulumEnsemble over the Cartesian product of the axes
+ * (here 1024 x 1024 cells), integrated in a single process with the
+ * batched Verlet kernels. The first axis in the file varies slowest, so a
+ * grid comes out row by row. Keys without a range keep their scalar value.
+ *
+ * SWEEP_OUTPUT selects the result:
+ *
+ *   final       one text line per cell: its initial conditions, its state
+ *               after TOTAL_TIME, its clamp events and whether ON_CLAMP=stop
+ *               ended it
+ *   flip-time   the time until either arm first flips over the top, as a
+ *               float image (PFM) over a two-axis grid; -1 marks cells that
+ *               do not flip within TOTAL_TIME. A cell stops at its flip, and
+ *               cells whose energy is below that of the lowest flipped
+ *               configuration are never integrated at all
+ */
+class ParameterSweep {
+private:
+    Config config;
+    PendulumEnsemble ensemble;
+    bool flipTimes;
+
+    // Cell index strides of the axes (the last axis has stride 1)
+    std::vector<size_t> strides;
+    size_t cellCount;
+
+    // Ensemble member of each cell, NO_MEMBER for cells that are not integrated
+    std::vector<size_t> members;
+    static const size_t NO_MEMBER = static_cast<size_t>(-1);
+
+    bool writeFinal(const std::string& filename) const;
+    bool writeFlipTimes(const std::string& filename) const;
+
+public:
+    // Builds the members from cfg.sweep; throws std::invalid_argument when
+    // METHOD is not verlet (the only scheme of the ensemble kernels), for an
+    // unknown SWEEP_OUTPUT, or for a flip-time map without exactly two axes
+    explicit ParameterSweep(const Config& cfg);
+
+    size_t size() const { return cellCount; }
+
+    // Initial theta1, theta2, omega1, omega2 of cell i
+    void initialConditions(size_t i, double state[4]) const;
+
+    // False when the energy of the state is too low for either arm to
+    // reach the upright position
+    static bool canFlip(const Config& cfg, const double state[4]);
+
+    // Integrate every cell over TOTAL_TIME
+    void run(ThreadPool& pool);
+
+    // Write the SWEEP_OUTPUT result; false when the file cannot be created
+    bool write(const std::string& filename) const;
+
+    const PendulumEnsemble& getEnsemble() const { return ensemble; }
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef PENDULUM_ENSEMBLE_HPP
+#define PENDULUM_ENSEMBLE_HPP
+
+#include "DoublePendulum.hpp"
+#include "SimdKernel.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Many independent double pendulums sharing one set of physical parameters.
+// States are kept as a structure of arrays so that a step streams through
+// contiguous memory instead of touching one DoublePendulum object at a time.
+//
+// Members that stop (ON_CLAMP=stop, flip detection) are periodically moved
+// behind the live ones, so the kernels only ever see dense blocks of live
+// states and a run costs in proportion to the members still live. Arrays
+// are indexed by slot; memberSlot / slotMember map between slots and the
+// member indices returned by addMember().
+class PendulumEnsemble {
+private:
+    Config config;
+    std::vector<double> theta1, theta2;
+    std::vector<double> omega1, omega2;
+    std::vector<double> theta1_old, theta2_old;
+
+    // Per-member clamp events and MemberStatus; a stopped member keeps its
+    // last state before the offending step and is no longer updated
+    std::vector<uint32_t> clampCount;
+    std::vector<uint8_t> status;
+    ClampPolicy clampPolicy;
+
+    // Flip detection (setStopOnFlip): time of the first flip, NaN until then
+    bool stopOnFlip;
+    std::vector<double> flipTime;
+
+    // Verlet steps taken since initialize()
+    long stepsTaken;
+
+    std::vector<size_t> memberSlot, slotMember;
+
+    // Acceleration kernel picked from config.simd at construction
+    SimdLevel simdLevel;
+    AccelerationBatchFn accelerationBatch;
+
+    // Advance slots [begin, end) by one Verlet step, the step-th since
+    // initialize(); returns the members still live
+    size_t stepRange(size_t begin, size_t end, long step);
+
+    // Move the live members to the front slots, returns how many there are
+    size_t compact();
+    void swapSlots(size_t a, size_t b);
+
+    // Both advance() overloads; pool may be null
+    void advanceLive(int steps, ThreadPool* pool);
+
+public:
+    enum MemberStatus {
+        LIVE = 0,
+        DIVERGED = 1,    // stopped by ON_CLAMP=stop
+        FLIPPED = 2      // stopped at its first flip (setStopOnFlip)
+    };
+
+    // Members processed together by advance(); six arrays of this many
+    // doubles stay resident in L1/L2 cache for the whole run
+    static const size_t BLOCK_SIZE = 512;
+
+    // Steps between compactions while members can stop
+    static const int COMPACT_INTERVAL = 128;
+
+    // Physical parameters, dt, the SIMD level and ON_CLAMP/CLAMP_LIMIT are
+    // taken from cfg, initial conditions are not. Vector kernels agree with
+    // DoublePendulum to about 1 ulp per step; SIMD=scalar reproduces it bit
+    // for bit. With ON_CLAMP=abort a step throws std::runtime_error
+    PendulumEnsemble(const Config& cfg);
+
+    void reserve(size_t n);
+
+    // Add a member with the given initial conditions, returns its index
+    size_t addMember(double theta1, double theta2, double omega1, double omega2);
+
+    size_t size() const { return theta1.size(); }
+
+    // Euler bootstrap of the old angles, identical to the first step of
+    // DoublePendulum::simulateAndOutputData
+    void initialize();
+
+    // Advance every member by one Verlet step
+    void step();
+
+    // Advance every member by the given number of Verlet steps, block by block.
+    // While members can stop, the live ones are compacted every
+    // COMPACT_INTERVAL steps and a block stops early once none is left
+    void advance(int steps);
+
+    // Same as advance(steps), with blocks spread over the pool's workers.
+    // Blocks never share state and compaction does not depend on the
+    // workers, so the result is bit-identical for any number of threads
+    void advance(int steps, ThreadPool& pool);
+
+    // Stop each member the first time either arm passes the upright
+    // position (|theta| crosses π), recording when. The flip time is
+    // interpolated linearly within the step
+    void setStopOnFlip(bool stop) { stopOnFlip = stop; }
+
+    // Member state access
+    double getTheta1(size_t i) const { return theta1[memberSlot[i]]; }
+    double getTheta2(size_t i) const { return theta2[memberSlot[i]]; }
+    double getOmega1(size_t i) const { return omega1[memberSlot[i]]; }
+    double getOmega2(size_t i) const { return omega2[memberSlot[i]]; }
+
+    // Clamp events of member i, counted like ClampCounters::total() of a
+    // single run: one per safeguard (MIN_DENOM, MAX_ACCEL) an evaluation hit
+    uint32_t getClampCount(size_t i) const { return clampCount[memberSlot[i]]; }
+    MemberStatus getStatus(size_t i) const { return static_cast<MemberStatus>(status[memberSlot[i]]); }
+    bool isDiverged(size_t i) const { return getStatus(i) == DIVERGED; }
+
+    // Time of the first flip of member i, NaN when it has not flipped
+    double getFlipTime(size_t i) const { return flipTime[memberSlot[i]]; }
+
+    // Totals over all members
+    uint64_t totalClampCount() const;
+    size_t divergedCount() const;
+    size_t flippedCount() const;
+
+    const Config& getConfig() const { return config; }
+    SimdLevel getSimdLevel() const { return simdLevel; }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+/*
+ * Hot-Path Instrumentation
+ * ========================
+ *
+ * Scoped timers and event counters for the simulation loop, built only with
+ * `make PROFILE=1` (which defines DP_PROFILE; run `make clean` when switching).
+ * Without it the DP_PROFILE_* macros expand to nothing, so the normal build
+ * carries no cost at all.
+ *
+ * Timers read the time-stamp counter (rdtsc) on x86 and steady_clock
+ * elsewhere; ticks are converted to seconds by comparing against
+ * steady_clock over the whole run. Each thread accumulates into its own
+ * totals, which are merged when the thread exits or the report is taken,
+ * so the hot path never touches shared memory.
+ *
+ *   DP_PROFILE_SCOPE(PHYSICS);            // time the enclosing block
+ *   DP_PROFILE_COUNT(SAMPLES, 1);         // add to a counter
+ *   DP_PROFILE_REPORT(std::cout, file);   // print, and write JSON if file != ""
+ */
+
+#ifdef DP_PROFILE
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace profile {
+
+// Timed phases of a run
+enum Phase {
+    PHYSICS,        // integrator steps
+    POSITIONS,      // angles -> ball positions for a sample
+    OUTPUT_QUEUE,   // handing samples to the output thread (waits included)
+    FORMATTING,     // writer sink: text or binary encoding, I/O included
+    IO,             // write() / fwrite() calls alone
+    PHASE_COUNT
+};
+
+// Event counters
+enum Counter {
+    STEPS,          // integrator steps (member-steps for an ensemble)
+    SAMPLES,        // samples handed to a writer
+    BYTES_WRITTEN,  // bytes passed to the operating system
+    CLAMPS,         // accelerationKernel calls that hit MIN_DENOM / MAX_ACCEL
+    COUNTER_COUNT
+};
+
+struct Totals {
+    uint64_t ticks[PHASE_COUNT];
+    uint64_t calls[PHASE_COUNT];
+    uint64_t counts[COUNTER_COUNT];
+};
+
+inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Per-thread totals: registered on first use, merged into the finished
+// totals when the thread exits
+struct ThreadTotals : Totals {
+    ThreadTotals();
+    ~ThreadTotals();
+};
+
+// Totals of the calling thread
+inline Totals& local() {
+    thread_local ThreadTotals totals;
+    return totals;
+}
+
+// Merge all threads' totals and print the breakdown; with a filename also
+// write it as JSON
+void report(std::ostream& out, const std::string& jsonFilename);
+
+class ScopedTimer {
+private:
+    Phase phase;
+    uint64_t start;
+
+public:
+    explicit ScopedTimer(Phase phase) : phase(phase), start(now()) {}
+    ~ScopedTimer() {
+        Totals& totals = local();
+        totals.ticks[phase] += now() - start;
+        totals.calls[phase]++;
+    }
+};
+
+}  // namespace profile
+
+#define DP_PROFILE_CONCAT2(a, b) a##b
+#define DP_PROFILE_CONCAT(a, b) DP_PROFILE_CONCAT2(a, b)
+#define DP_PROFILE_SCOPE(phase) \
+    profile::ScopedTimer DP_PROFILE_CONCAT(profileTimer, __LINE__)(profile::phase)
+#define DP_PROFILE_COUNT(counter, n) (profile::local().counts[profile::counter] += (n))
+#define DP_PROFILE_REPORT(out, jsonFilename) profile::report(out, jsonFilename)
+
+#else
+
+#define DP_PROFILE_SCOPE(phase) ((void)0)
+#define DP_PROFILE_COUNT(counter, n) ((void)0)
+#define DP_PROFILE_REPORT(out, jsonFilename) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SIMD_KERNEL_HPP
+#define SIMD_KERNEL_HPP
+
+#include "DoublePendulum.hpp"
+#include <cstddef>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DP_SIMD_X86 1
+#endif
+
+// Instruction set used by the batched acceleration kernel
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2 = 1,    // 2 pendulums per instruction
+    SIMD_AVX2 = 2,    // 4 pendulums per instruction (AVX2 + FMA)
+    SIMD_AVX512 = 3   // 8 pendulums per instruction (AVX-512F)
+};
+
+// Angular accelerations of n independent states stored as arrays, and the
+// ClampFlags of each evaluation
+typedef void (*AccelerationBatchFn)(const Config& cfg,
+                                    const double* theta1, const double* theta2,
+                                    const double* omega1, const double* omega2,
+                                    double* alpha1, double* alpha2,
+                                    unsigned* flags, size_t n);
+
+// Best level supported by this CPU (queried once through CPUID)
+SimdLevel detectSimdLevel();
+
+// Parse the SIMD config value: auto, scalar, sse2, avx2 or avx512.
+// auto and any level the CPU cannot run resolve to detectSimdLevel()
+SimdLevel parseSimdLevel(const std::string& name);
+
+const char* simdLevelName(SimdLevel level);
+
+// Kernel implementing the given level
+AccelerationBatchFn selectAccelerationKernel(SimdLevel level);
+
+// Portable reference kernel: DoublePendulum::accelerationKernel in a loop
+void accelerationBatchScalar(const Config& cfg,
+                             const double* theta1, const double* theta2,
+                             const double* omega1, const double* omega2,
+                             double* alpha1, double* alpha2,
+                             unsigned* flags, size_t n);
+
+#ifdef DP_SIMD_X86
+// Each of these lives in its own translation unit built with the matching
+// -m flags, so only the dispatcher may call them
+void accelerationBatchSSE2(const Config& cfg,
+                           const double* theta1, const double* theta2,
+                           const double* omega1, const double* omega2,
+                           double* alpha1, double* alpha2,
+                           unsigned* flags, size_t n);
+void accelerationBatchAVX2(const Config& cfg,
+                           const double* theta1, const double* theta2,
+                           const double* omega1, const double* omega2,
+                           double* alpha1, double* alpha2,
+                           unsigned* flags, size_t n);
+void accelerationBatchAVX512(const Config& cfg,
+                             const double* theta1, const double* theta2,
+                             const double* omega1, const double* omega2,
+                             double* alpha1, double* alpha2,
+                             unsigned* flags, size_t n);
+#endif
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef SIMD_MATH_HPP
+#define SIMD_MATH_HPP
+
+#include "DoublePendulum.hpp"
+#include <cstddef>
+
+/*
+ * Width-generic vector math shared by the SSE2/AVX2/AVX-512 kernels
+ * ==================================================================
+ *
+ * Every function is a template over an ISA traits struct S providing
+ *   S::V     vector of doubles,  S::M  lane mask,  S::WIDTH  lane count
+ *   load/store/set1/add/sub/mul/div/fmadd/min/max/abs
+ *   lt/ge (compare -> mask), select(m, a, b) = m ? a : b, maskXor
+ *   truncate(v)       round toward zero, |v| < 2^31
+ *   bitSet<BIT>(v)    mask of lanes whose integer value has BIT set
+ *
+ * Each ISA translation unit defines its traits struct in an anonymous
+ * namespace, so every instantiation below has internal linkage and the
+ * linker can never mix up code compiled for different instruction sets.
+ */
+
+// Vectorized sine and cosine of the same argument (Cephes sin.c/cos.c
+// algorithm: octant reduction with a three-part Cody-Waite pi/4, then
+// degree 13/14 minimax polynomials on [-pi/4, pi/4]; about 1 ulp)
+template <class S>
+inline void simdSinCos(typename S::V x, typename S::V& s, typename S::V& c) {
+    typedef typename S::V V;
+    typedef typename S::M M;
+
+    const V zero = S::set1(0.0);
+    const V one = S::set1(1.0);
+
+    M negative = S::lt(x, zero);
+    V ax = S::abs(x);
+
+    // Octant index, rounded up to even so that z lies in [-pi/4, pi/4]
+    V y = S::truncate(S::mul(ax, S::set1(1.27323954473516268615)));  // 4/pi
+    y = S::add(y, S::select(S::template bitSet<0>(y), one, zero));
+
+    M upperHalf = S::template bitSet<2>(y);   // octants 4..7: flip the sign
+    M swapPoly = S::template bitSet<1>(y);    // octants 2, 6: sin and cos trade places
+
+    V z = S::fmadd(y, S::set1(-7.85398125648498535156E-1), ax);
+    z = S::fmadd(y, S::set1(-3.77489470793079817668E-8), z);
+    z = S::fmadd(y, S::set1(-2.69515142907905952645E-15), z);
+    V zz = S::mul(z, z);
+
+    V ps = S::set1(1.58962301576546568060E-10);
+    ps = S::fmadd(ps, zz, S::set1(-2.50507477628578072866E-8));
+    ps = S::fmadd(ps, zz, S::set1(2.75573136213857245213E-6));
+    ps = S::fmadd(ps, zz, S::set1(-1.98412698295895385996E-4));
+    ps = S::fmadd(ps, zz, S::set1(8.33333333332211858878E-3));
+    ps = S::fmadd(ps, zz, S::set1(-1.66666666666666307295E-1));
+    ps = S::fmadd(S::mul(z, zz), ps, z);
+
+    V pc = S::set1(-1.13585365213876817300E-11);
+    pc = S::fmadd(pc, zz, S::set1(2.08757008419747316778E-9));
+    pc = S::fmadd(pc, zz, S::set1(-2.75573141792967388112E-7));
+    pc = S::fmadd(pc, zz, S::set1(2.48015872888517045348E-5));
+    pc = S::fmadd(pc, zz, S::set1(-1.38888888888730564116E-3));
+    pc = S::fmadd(pc, zz, S::set1(4.16666666666665929218E-2));
+    pc = S::fmadd(S::mul(zz, zz), pc, S::fmadd(S::set1(-0.5), zz, one));
+
+    V sinv = S::select(swapPoly, pc, ps);
+    V cosv = S::select(swapPoly, ps, pc);
+
+    s = S::select(S::maskXor(upperHalf, negative), S::sub(zero, sinv), sinv);
+    c = S::select(S::maskXor(upperHalf, swapPoly), S::sub(zero, cosv), cosv);
+}
+
+// Branch-free replacement for: if (|d| < MIN) d = (d >= 0) ? MIN : -MIN
+template <class S>
+inline typename S::V simdClampDenominator(typename S::V d, double minDenom) {
+    typedef typename S::V V;
+    V limit = S::set1(minDenom);
+    V nudged = S::select(S::ge(d, S::set1(0.0)), limit, S::set1(-minDenom));
+    return S::select(S::lt(S::abs(d), limit), nudged, d);
+}
+
+// One vector of pendulums; same formula as DoublePendulum::accelerationKernel.
+// flags holds the ClampFlags of each lane as a double
+template <class S>
+inline void simdAccelerationVector(const Config& cfg,
+                                   typename S::V theta1, typename S::V theta2,
+                                   typename S::V omega1, typename S::V omega2,
+                                   typename S::V& alpha1, typename S::V& alpha2, typename S::V& flags) {
+    typedef typename S::V V;
+
+    const double MIN_DENOM = DoublePendulum::MIN_DENOM;
+    const double MAX_ACCEL = DoublePendulum::MAX_ACCEL;
+
+    const V L1 = S::set1(cfg.L1), L2 = S::set1(cfg.L2);
+    const V M2 = S::set1(cfg.M2), M12 = S::set1(cfg.M1 + cfg.M2);
+    const V g = S::set1(cfg.G);
+
+    // Two sincos and the angle-addition identities, as in PendulumTrig
+    V sin1, cos1, sin2, cos2;
+    simdSinCos<S>(theta1, sin1, cos1);
+    simdSinCos<S>(theta2, sin2, cos2);
+    V sin_delta = S::sub(S::mul(sin2, cos1), S::mul(cos2, sin1));
+    V cos_delta = S::add(S::mul(cos2, cos1), S::mul(sin2, sin1));
+
+    V denom1 = S::sub(S::mul(M12, L1), S::mul(S::mul(S::mul(M2, L1), cos_delta), cos_delta));
+    V denom2 = S::mul(S::set1(cfg.L2 / cfg.L1), denom1);
+
+    // ClampFlags as doubles: 1 when either denominator is nudged, plus 2
+    // when either acceleration is clamped
+    const V zero = S::set1(0.0);
+    V smallest = S::min(S::abs(denom1), S::abs(denom2));
+    V denominatorClamped = S::select(S::lt(smallest, S::set1(MIN_DENOM)), S::set1(1.0), zero);
+    denom1 = simdClampDenominator<S>(denom1, MIN_DENOM);
+    denom2 = simdClampDenominator<S>(denom2, MIN_DENOM);
+
+    V w1sq = S::mul(omega1, omega1);
+    V w2sq = S::mul(omega2, omega2);
+    V sc = S::mul(sin_delta, cos_delta);
+
+    V num1 = S::mul(S::mul(S::mul(M2, L2), w2sq), sin_delta);
+    num1 = S::add(num1, S::mul(S::mul(S::mul(M2, L1), w1sq), sc));
+    num1 = S::add(num1, S::mul(S::mul(S::mul(M2, g), sin2), cos_delta));
+    num1 = S::sub(num1, S::mul(S::mul(M12, g), sin1));
+
+    V num2 = S::mul(S::mul(S::mul(M12, g), sin1), cos_delta);
+    num2 = S::sub(num2, S::mul(S::mul(S::mul(M2, L2), w2sq), sc));
+    num2 = S::sub(num2, S::mul(S::mul(S::mul(M12, L1), w1sq), sin_delta));
+    num2 = S::sub(num2, S::mul(S::mul(M12, g), sin2));
+
+    const V hi = S::set1(MAX_ACCEL), lo = S::set1(-MAX_ACCEL);
+    V raw1 = S::div(num1, denom1), raw2 = S::div(num2, denom2);
+    V accelerationClamped = S::select(S::lt(hi, S::abs(raw2)), S::set1(2.0), zero);
+    accelerationClamped = S::select(S::lt(hi, S::abs(raw1)), S::set1(2.0), accelerationClamped);
+    flags = S::add(denominatorClamped, accelerationClamped);
+    alpha1 = S::max(lo, S::min(hi, raw1));
+    alpha2 = S::max(lo, S::min(hi, raw2));
+}
+
+// Whole arrays; the tail is padded into a full vector instead of falling
+// back to libm so the results do not depend on where a member sits
+template <class S>
+inline void simdAccelerationBatch(const Config& cfg,
+                                  const double* theta1, const double* theta2,
+                                  const double* omega1, const double* omega2,
+                                  double* alpha1, double* alpha2,
+                                  unsigned* flags, size_t n) {
+    typedef typename S::V V;
+    const size_t W = S::WIDTH;
+
+    size_t i = 0;
+    double f[S::WIDTH];
+    for (; i + W <= n; i += W) {
+        V a1, a2, fv;
+        simdAccelerationVector<S>(cfg, S::load(theta1 + i), S::load(theta2 + i),
+                                  S::load(omega1 + i), S::load(omega2 + i), a1, a2, fv);
+        S::store(alpha1 + i, a1);
+        S::store(alpha2 + i, a2);
+        S::store(f, fv);
+        for (size_t k = 0; k < W; k++) flags[i + k] = static_cast<int>(f[k]);
+    }
+
+    if (i < n) {
+        double t1[S::WIDTH], t2[S::WIDTH], w1[S::WIDTH], w2[S::WIDTH];
+        double a1[S::WIDTH], a2[S::WIDTH];
+        for (size_t k = 0; k < W; k++) {
+            bool live = i + k < n;
+            t1[k] = live ? theta1[i + k] : 0.0;
+            t2[k] = live ? theta2[i + k] : 0.0;
+            w1[k] = live ? omega1[i + k] : 0.0;
+            w2[k] = live ? omega2[i + k] : 0.0;
+        }
+        V v1, v2, fv;
+        simdAccelerationVector<S>(cfg, S::load(t1), S::load(t2), S::load(w1), S::load(w2), v1, v2, fv);
+        S::store(a1, v1);
+        S::store(a2, v2);
+        S::store(f, fv);
+        for (size_t k = 0; i + k < n; k++) {
+            alpha1[i + k] = a1[k];
+            alpha2[i + k] = a2[k];
+            flags[i + k] = static_cast<int>(f[k]);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef SIMULATION_LOOP_HPP
+#define SIMULATION_LOOP_HPP
+
+#include "DoublePendulum.hpp"
+#include "DormandPrince.hpp"
+#include "Energy.hpp"
+#include "OutputScheduler.hpp"
+#include "Stepper.hpp"
+#include "TrajectoryWriter.hpp"
+#include <memory>
+#include <type_traits>
+
+/*
+ * Integration Loops
+ * =================
+ *
+ * The loops of DoublePendulum are templates over the sample sink, any
+ * callable taking a const Sample&. Each sample the OUTPUT_MODE schedule asks
+ * for is built on the integrating thread and passed straight to the sink, so
+ * the call inlines into the loop like a hand-written reduction would:
+ *
+ *   DoublePendulum pendulum(config);
+ *   double highest = -INFINITY;
+ *   pendulum.simulate([&](const Sample& s) { highest = std::max(highest, s.y2); });
+ *
+ * The file output of the simulateAndOutput* functions is the sink
+ * AsyncTrajectoryWriter, which moves samples to its writer thread. Only that
+ * sink gets CHECKPOINT files, since a resumed run has to cut the output back
+ * to the checkpoint. The loops write nothing to the console; progress, step
+ * counts, clamp events and energy statistics are printed by the
+ * simulateAndOutput* functions from what the run leaves in the object.
+ */
+
+template <typename Sink>
+void DoublePendulum::simulate(Sink&& sink) {
+    EnergyMonitor energy(config);
+    integrate(sink, config.energy != "off" ? &energy : nullptr);
+}
+
+template <typename Sink>
+void DoublePendulum::integrate(Sink& sink, EnergyMonitor* energy) {
+    // Fixed-step methods go through a Stepper, dopri5 has its own loop
+    std::unique_ptr<Stepper> stepper;
+    if (config.method != "dopri5") {
+        stepper = createStepper(config);
+    }
+
+    // Which steps produce a sample (OUTPUT_MODE)
+    OutputScheduler schedule(config);
+    divergence.clear();
+
+    if (resuming) {
+        // The integrators restore their own part
+        schedule.restore(restart);
+        if (energy) {
+            energy->restore(restart);
+        }
+    }
+
+    if (stepper) {
+        integrateFixedStep(*stepper, schedule, sink, energy);
+    } else {
+        integrateDormandPrince(schedule, sink, energy);
+    }
+
+    // The checkpoint is used up; a further run starts from the current state
+    resuming = false;
+}
+
+template <typename Sink>
+void DoublePendulum::integrateFixedStep(Stepper& stepper, OutputScheduler& schedule,
+                                        Sink& sink, EnergyMonitor* energy) {
+    constexpr bool fileOutput = std::is_same<Sink, AsyncTrajectoryWriter>::value;
+    double t = 0.0;
+    int steps = fixedStepCount();
+    int first = 0;
+
+    PendulumState state = {theta1, theta2, omega1, omega2, theta1_old, theta2_old};
+
+    if (resuming) {
+        first = static_cast<int>(restart.step);
+        t = restart.time;
+        state = {restart.state[0], restart.state[1], restart.state[2],
+                 restart.state[3], restart.state[4], restart.state[5]};
+        stepper.restore(restart);
+    }
+
+    for (int i = first; i < steps; i++) {
+        if (i > 0) {  // The first sample is the initial state
+            DP_PROFILE_SCOPE(PHYSICS);
+            DP_PROFILE_COUNT(STEPS, 1);
+            stepper.step(state);
+        } else {
+            stepper.start(state);
+        }
+
+        // The state is no longer trustworthy once the safeguards fire
+        if (exceedsClampLimit(stepper.clamps(), t)) {
+            break;
+        }
+
+        // Energy and sample share one PendulumTrig, the stepper's own when
+        // it has one; the energy is taken at the angles the velocities
+        // belong to (theta_old after a verlet step)
+        const bool sampleDue = schedule.due(i, t, state.theta1, state.theta2, state.omega1, state.omega2);
+        if (energy || sampleDue) {
+            const PendulumTrig* stepperTrig = stepper.stateTrig();
+            const PendulumTrig trig = stepperTrig ? *stepperTrig : PendulumTrig(state.theta1, state.theta2);
+            const PendulumTrig* laggingTrig = stepper.velocityTrig();
+            const PendulumTrig& energyTrig = laggingTrig ? *laggingTrig : trig;
+
+            if (energy) {
+                energy->add(pendulumEnergy(config, energyTrig, state.omega1, state.omega2).total());
+            }
+
+            // Output data when the schedule asks for a sample
+            if (sampleDue) {
+                theta1 = state.theta1;
+                theta2 = state.theta2;
+                omega1 = state.omega1;
+                omega2 = state.omega2;
+                sink(currentSample(t, trig, energyTrig));
+            }
+        }
+
+        t += config.dt;
+
+        // Periodic checkpoint of the state after this step
+        if constexpr (fileOutput) {
+            if (!config.checkpoint.empty() && (i + 1) % config.checkpointEvery == 0 && i + 1 < steps) {
+                Checkpoint checkpoint = newCheckpoint(config);
+                checkpoint.step = i + 1;
+                checkpoint.time = t;
+                const double words[6] = {state.theta1, state.theta2, state.omega1,
+                                         state.omega2, state.theta1_old, state.theta2_old};
+                std::copy(words, words + 6, checkpoint.state);
+                stepper.save(checkpoint);
+                saveCheckpoint(checkpoint, schedule, sink, energy);
+            }
+        }
+    }
+
+    // Leave the object at the final state
+    theta1 = state.theta1;
+    theta2 = state.theta2;
+    omega1 = state.omega1;
+    omega2 = state.omega2;
+    theta1_old = state.theta1_old;
+    theta2_old = state.theta2_old;
+    clamps.add(stepper.clamps());
+}
+
+template <typename Sink>
+void DoublePendulum::integrateDormandPrince(OutputScheduler& schedule, Sink& sink, EnergyMonitor* energy) {
+    constexpr bool fileOutput = std::is_same<Sink, AsyncTrajectoryWriter>::value;
+    const double totalTime = config.totalTime;
+
+    DormandPrince stepper(config);
+    double y[4] = {theta1, theta2, omega1, omega2};
+    long long nextSample = 1;
+
+    if (resuming) {
+        stepper.restore(restart);
+        nextSample = restart.sampleIndex;
+    } else {
+        stepper.reset(0.0, y);
+        if (energy) {
+            energy->add(pendulumEnergy(config, y[0], y[1], y[2], y[3]).total());
+        }
+
+        // The first sample is the initial state, like the Verlet loop
+        sink(currentSample(0.0));
+    }
+
+    while (stepper.time() < totalTime) {
+        {
+            DP_PROFILE_SCOPE(PHYSICS);
+            DP_PROFILE_COUNT(STEPS, 1);
+            stepper.step(totalTime);
+        }
+        if (exceedsClampLimit(stepper.clamps(), stepper.time())) {
+            break;
+        }
+
+        if (energy) {
+            const double* s = stepper.state();
+            energy->add(pendulumEnergy(config, s[0], s[1], s[2], s[3]).total());
+        }
+
+        if (schedule.isTimeBased()) {
+            // Samples that fall inside the step come from dense output; the
+            // run covers [0, TOTAL_TIME) like the Verlet loop
+            double ts;
+            while ((ts = schedule.sampleTime(nextSample)) <= stepper.time() &&
+                   ts < totalTime * (1 - 1e-12)) {
+                stepper.interpolate(ts, y);
+                theta1 = normalizeAngle(y[0]);
+                theta2 = normalizeAngle(y[1]);
+                omega1 = y[2];
+                omega2 = y[3];
+                sink(currentSample(ts));
+                nextSample++;
+            }
+        } else {
+            const double* s = stepper.state();
+            double h = stepper.time() - stepper.previousTime();
+            double length = h * schedule.bobSpeed(s[0], s[1], s[2], s[3]);
+            if (schedule.dueAfterTravel(length) && stepper.time() < totalTime) {
+                theta1 = normalizeAngle(s[0]);
+                theta2 = normalizeAngle(s[1]);
+                omega1 = s[2];
+                omega2 = s[3];
+                sink(currentSample(stepper.time()));
+            }
+        }
+
+        // Periodic checkpoint after this accepted step
+        if constexpr (fileOutput) {
+            if (!config.checkpoint.empty() && stepper.acceptedSteps() % config.checkpointEvery == 0 &&
+                stepper.time() < totalTime) {
+                Checkpoint checkpoint = newCheckpoint(config);
+                stepper.save(checkpoint);
+                checkpoint.sampleIndex = nextSample;
+                saveCheckpoint(checkpoint, schedule, sink, energy);
+            }
+        }
+    }
+
+    // Leave the object at the final state
+    const double* s = stepper.state();
+    theta1 = theta1_old = normalizeAngle(s[0]);
+    theta2 = theta2_old = normalizeAngle(s[1]);
+    omega1 = s[2];
+    omega2 = s[3];
+
+    clamps.add(stepper.clamps());
+    acceptedSteps = stepper.acceptedSteps();
+    rejectedSteps = stepper.rejectedSteps();
+}
+
+#endif
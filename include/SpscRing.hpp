@@ -0,0 +1,91 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. push() and pop() never block; they report a full or empty ring.
+template <class T>
+class SpscRing {
+private:
+    std::vector<T> slots;
+
+    // Head and tail sit on separate cache lines so the two threads do not
+    // invalidate each other's line on every operation
+    char padHead[64];
+    std::atomic<size_t> head;   // next slot to pop, written by the consumer
+    char padTail[64];
+    std::atomic<size_t> tail;   // next slot to push, written by the producer
+    char padEnd[64];
+
+    size_t next(size_t index) const { return index + 1 == slots.size() ? 0 : index + 1; }
+
+public:
+    // One slot stays empty to tell a full ring from an empty one
+    explicit SpscRing(size_t capacity) : slots(capacity + 1), head(0), tail(0) {}
+
+    bool push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t n = next(t);
+        if (n == head.load(std::memory_order_acquire)) return false;
+        slots[t] = value;
+        tail.store(n, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        value = slots[h];
+        head.store(next(h), std::memory_order_release);
+        return true;
+    }
+};
+
+// Lets one thread sleep until another thread makes a condition true, e.g.
+// until a ring it polls has an entry. wait() spins briefly, then parks on a
+// condition variable; notify() only takes the mutex while the waiter is
+// parked, so the other thread's common path stays a fence and a load
+class WakeSignal {
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::atomic<bool> parked;
+
+    static const int SPIN_LIMIT = 64;
+
+public:
+    WakeSignal() : parked(false) {}
+
+    // Return once ready() is true; ready may act on success (pop an entry)
+    template <class Ready>
+    void wait(Ready ready) {
+        for (int i = 0; i < SPIN_LIMIT; i++) {
+            if (ready()) return;
+        }
+
+        // Publishing parked before ready() is checked again pairs with the
+        // fence in notify(): either notify() sees parked, or this check sees
+        // the change notify() announces
+        std::unique_lock<std::mutex> lock(mutex);
+        parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition.wait(lock, ready);
+        parked.store(false, std::memory_order_relaxed);
+    }
+
+    // Called after the change that may make the waiter's condition true
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_one();
+        }
+    }
+};
+
+#endif
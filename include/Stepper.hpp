@@ -0,0 +1,164 @@
+#ifndef STEPPER_HPP
+#define STEPPER_HPP
+
+#include "DoublePendulum.hpp"
+#include "Checkpoint.hpp"
+#include <memory>
+#include <vector>
+
+// State advanced by a fixed-step integrator
+struct PendulumState {
+    double theta1, theta2;
+    double omega1, omega2;
+    double theta1_old, theta2_old;   // angles one step back (two-step methods)
+};
+
+/*
+ * Fixed-step integrator selected with the METHOD key. DoublePendulum calls
+ * start() once with the initial state, then step() once per DT; angles come
+ * back normalized to [-π, π], with theta_old moved by the same multiple of
+ * 2π (DoublePendulum::wrapAngle).
+ */
+class Stepper {
+protected:
+    ClampCounters clampCounters;
+
+public:
+    virtual ~Stepper() {}
+
+    virtual void start(PendulumState& state) = 0;
+    virtual void step(PendulumState& state) = 0;
+
+    // Clamp counters and any internal state beyond PendulumState; after
+    // restore() the next step() continues bit-exactly where save() was
+    virtual void save(Checkpoint& checkpoint) const;
+    virtual void restore(const Checkpoint& checkpoint);
+
+    // Clamp events of accelerationKernel since construction
+    const ClampCounters& clamps() const { return clampCounters; }
+
+    // PendulumTrig of the angles start() or step() last handed out, when the
+    // stepper computed it anyway; null otherwise. Only valid until the state
+    // or the stepper changes
+    virtual const PendulumTrig* stateTrig() const { return nullptr; }
+
+    // PendulumTrig of the angles the angular velocities of the state belong
+    // to, when those are not the state's own angles; null otherwise. Energy
+    // needs angles and velocities of one instant
+    virtual const PendulumTrig* velocityTrig() const { return nullptr; }
+};
+
+/*
+ * The original scheme: position Verlet with central-difference velocities,
+ * bootstrapped by one Euler step backwards. Same arithmetic as
+ * DoublePendulum::verletStep. Params is the parameter policy of
+ * accelerationKernel; createStepper instantiates the one
+ * KernelCoefficients selects.
+ *
+ * The PendulumTrig of the new angles is computed at the end of a step and
+ * serves the acceleration of the next one as well as the positions of the
+ * sample in between (stateTrig), so a step costs two sincos. The central
+ * difference gives the velocity one step back, at theta_old, so the energy
+ * of a step is taken there, from the PendulumTrig the step started with
+ * (velocityTrig).
+ */
+template <typename Params = PendulumCoefficients>
+class VerletStepper : public Stepper {
+private:
+    Config config;
+    Params params;
+
+    // PendulumTrig of (trigTheta1, trigTheta2), the angles last handed out
+    PendulumTrig trig;
+    double trigTheta1, trigTheta2;
+
+    // PendulumTrig of the angles the velocities belong to: the state's
+    // after start(), theta_old after step()
+    PendulumTrig previous;
+
+    // trig for the angles of state, recomputed when the caller changed them
+    const PendulumTrig& trigOf(const PendulumState& state);
+
+public:
+    explicit VerletStepper(const Config& cfg)
+        : config(cfg), params(cfg), trig(), trigTheta1(NAN), trigTheta2(NAN), previous() {}
+
+    void start(PendulumState& state) override;
+    void step(PendulumState& state) override;
+
+    const PendulumTrig* stateTrig() const override { return &trig; }
+    const PendulumTrig* velocityTrig() const override { return &previous; }
+};
+
+/*
+ * Composition Methods
+ * ===================
+ *
+ * A step of size h is the product of s substeps of a symmetric second order
+ * base method $\Phi$:
+ *   $\Psi_h = \Phi_{w_s h} \circ \cdots \circ \Phi_{w_1 h}$
+ * With symmetric weights chosen by Yoshida (1990) the local error drops to
+ * order 4, 6 or 8 while every substep stays symplectic:
+ *
+ *   forest-ruth, yoshida4   3 substeps, $w = (\gamma, 1 - 2\gamma, \gamma)$,
+ *                           $\gamma = 1 / (2 - 2^{1/3})$ (the triple jump,
+ *                           found independently by Forest & Ruth)
+ *   yoshida6                7 substeps, Yoshida's solution A
+ *   yoshida8                15 substeps, Yoshida's solution D
+ *
+ * The base method works on the canonical state $(\theta, p)$ and uses the
+ * closed-form Hamilton's equations of Hamiltonian.hpp, so it is exactly
+ * symplectic and the energy error stays bounded over long runs instead of
+ * drifting:
+ *
+ *   implicit midpoint   $z' = z + h f(\frac{z + z'}{2})$ (used by the
+ *                       compositions, and alone as METHOD=midpoint)
+ *   Stormer-Verlet      the partitioned scheme for non-separable H
+ *                       (METHOD=stormer-verlet); its momentum stage keeps
+ *                       the angles fixed and reuses their sines and cosines
+ *
+ * The implicit equations are solved by fixed-point iteration, which needs
+ * roughly $|w_i| h\,|\omega| < 1$; a DT too large for that is reported as an
+ * error. The acceleration clamps of accelerationKernel do not apply here.
+ */
+class CompositionStepper : public Stepper {
+public:
+    enum Base { IMPLICIT_MIDPOINT, STORMER_VERLET };
+
+private:
+    Config config;
+    std::vector<double> weights;
+    Base base;
+
+    // Canonical state after the last step, reused when the next step starts
+    // from the state that was handed out
+    PendulumState last;
+    double p1, p2;
+
+    // theta' and p' at (theta1, theta2, p1, p2)
+    void derivatives(const double z[4], double dz[4]) const;
+
+    // One base substep of size h on z = (theta1, theta2, p1, p2); throws
+    // std::runtime_error when the iteration does not converge
+    void midpoint(double z[4], double h) const;
+    void stormerVerlet(double z[4], double h) const;
+
+public:
+    // Weights of the substeps, in units of DT
+    CompositionStepper(const Config& cfg, const std::vector<double>& weights, Base base);
+
+    void start(PendulumState& state) override;
+    void step(PendulumState& state) override;
+
+    // Also keeps the canonical momenta, so a resumed run does not round
+    // through omega -> p
+    void save(Checkpoint& checkpoint) const override;
+    void restore(const Checkpoint& checkpoint) override;
+};
+
+// Stepper for a fixed-step METHOD (verlet, midpoint, stormer-verlet,
+// forest-ruth, yoshida4, yoshida6, yoshida8); throws std::invalid_argument
+// for any other name
+std::unique_ptr<Stepper> createStepper(const Config& cfg);
+
+#endif
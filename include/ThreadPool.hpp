@@ -0,0 +1,62 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque per worker. A worker pops
+// its own tasks from the back and, once it runs dry, steals from the front
+// of the other deques, so uneven chunks still keep every core busy.
+class ThreadPool {
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    // Current parallelFor job
+    const std::function<void(size_t)>* job;
+    std::atomic<size_t> remaining;
+    std::exception_ptr failure;
+
+    std::mutex stateMutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable jobDone;
+    unsigned long generation;
+    bool stopping;
+
+    void workerLoop(size_t self);
+
+    // Run tasks from our own deque, then steal, until no task is left
+    void runTasks(size_t self);
+    bool popTask(size_t self, size_t& task);
+    bool stealTask(size_t self, size_t& task);
+
+public:
+    // threads = 0 uses every hardware thread; the calling thread counts as one
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+    // Call fn(task) for every task in [0, tasks) and wait for all of them.
+    // Tasks are dealt out in contiguous runs, one run per worker. The first
+    // exception thrown by fn is rethrown here once the job has drained.
+    void parallelFor(size_t tasks, const std::function<void(size_t)>& fn);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef TRAJECTORY_FILE_HPP
+#define TRAJECTORY_FILE_HPP
+
+#include "DoublePendulum.hpp"
+#include "TrajectoryWriter.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Binary Columnar Trajectory Format
+ * =================================
+ *
+ * Values are IEEE-754 doubles in the byte order of the machine that wrote
+ * the file, so it can be mapped without conversion. byteOrder records that
+ * order (TRAJECTORY_BYTE_ORDER as written there); TrajectoryReader refuses a
+ * file from a machine of the other order, visualize.py reads both:
+ *
+ *   [TrajectoryHeader, 256 bytes]
+ *   [block 0: column 0 x blockSamples][column 1 x blockSamples]...
+ *   [block 1: ...]
+ *
+ * Every block holds the same number of samples per column; the last block is
+ * zero padded and sampleCount tells how many samples are valid. A block is
+ * therefore a (columnCount, blockSamples) array and the whole data section a
+ * (blocks, columnCount, blockSamples) array that can be memory mapped as is
+ * (see TrajectoryReader and visualize.py).
+ */
+
+struct TrajectoryHeader {
+    char magic[8];            // "DPTRAJ\0\0"
+    uint32_t version;
+    uint32_t columnCount;
+    uint64_t blockSamples;
+    uint64_t sampleCount;
+    double config[11];        // L1 L2 M1 M2 G THETA1 THETA2 OMEGA1 OMEGA2 DT TOTAL_TIME
+    char columnNames[16][8];  // NUL padded, columnCount entries used
+    uint32_t byteOrder;       // TRAJECTORY_BYTE_ORDER in the writer's byte order
+    char reserved[4];
+};
+
+static_assert(sizeof(TrajectoryHeader) == 256, "TrajectoryHeader must stay 256 bytes");
+
+static const char TRAJECTORY_MAGIC[8] = {'D', 'P', 'T', 'R', 'A', 'J', '\0', '\0'};
+static const uint32_t TRAJECTORY_VERSION = 1;
+static const uint32_t TRAJECTORY_BYTE_ORDER = 0x01020304;
+
+// Writes samples (t x1 y1 x2 y2 theta1 theta2) in the columnar format
+class BinaryTrajectoryWriter : public TrajectoryWriter {
+private:
+    std::FILE* file;
+    TrajectoryHeader header;
+    std::vector<double> block;   // columnCount x blockSamples, column major
+    size_t fill;                 // samples in the current block
+    bool failed;                 // a write failed, reported once
+
+    void writeAll(const void* data, size_t size, size_t count);
+
+    // Write the current block, zero padded, at the file position
+    void writeBlock();
+    void flushBlock();
+
+public:
+    static const size_t DEFAULT_BLOCK_SAMPLES = 4096;
+
+    BinaryTrajectoryWriter();
+    ~BinaryTrajectoryWriter();
+
+    // Create the file and write a provisional header, false on failure
+    bool open(const std::string& filename, const Config& config,
+              size_t blockSamples = DEFAULT_BLOCK_SAMPLES);
+
+    // Reopen the file of a checkpointed run, cut back to the checkpoint;
+    // false when it cannot be opened or holds fewer samples
+    bool resume(const std::string& filename, const Checkpoint& checkpoint);
+
+    void append(const Sample& sample);
+    void write(const Sample* samples, size_t count) override;
+
+    // Write the partial block and a header with the current sample count,
+    // then sync; the block is written again once it fills up
+    void checkpoint(Checkpoint& checkpoint) override;
+
+    // Write the last block and the final sample count; false when any write
+    // failed
+    bool close() override;
+
+    bool isOpen() const { return file != nullptr; }
+};
+
+// Zero-copy reader: the file is memory mapped and columns are read in place
+class TrajectoryReader {
+private:
+    const unsigned char* base;
+    size_t length;
+    const TrajectoryHeader* header;
+
+public:
+    TrajectoryReader();
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    // Map the file and validate the header, throws std::runtime_error (also
+    // for a file written in the other byte order)
+    void open(const std::string& filename);
+    void close();
+
+    size_t sampleCount() const { return header->sampleCount; }
+    size_t columnCount() const { return header->columnCount; }
+    size_t blockSamples() const { return header->blockSamples; }
+    size_t blockCount() const {
+        return sampleCount() / blockSamples() + (sampleCount() % blockSamples() != 0);
+    }
+
+    // Column index by name ("t", "x1", ..., "theta2"), -1 if absent
+    int columnIndex(const std::string& name) const;
+
+    // Contiguous samples of one column within one block
+    const double* column(size_t block, size_t column) const;
+
+    // Single value, i counted over the whole run
+    double value(size_t column, size_t i) const {
+        return this->column(i / blockSamples(), column)[i % blockSamples()];
+    }
+
+    // Simulation parameters stored in the header
+    Config config() const;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef TRAJECTORY_WRITER_HPP
+#define TRAJECTORY_WRITER_HPP
+
+#include "DoublePendulum.hpp"
+#include "Checkpoint.hpp"
+#include "SpscRing.hpp"
+#include "AsciiEmitter.hpp"
+#include "Profiler.hpp"
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Destination for output samples (text files, binary file, ...)
+class TrajectoryWriter {
+public:
+    virtual ~TrajectoryWriter() {}
+
+    virtual void write(const Sample* samples, size_t count) = 0;
+
+    // Get everything written so far onto the disk and record its length in
+    // checkpoint.output
+    virtual void checkpoint(Checkpoint& checkpoint) = 0;
+
+    // Flush everything and release the destination; false when any write
+    // failed
+    virtual bool close() = 0;
+};
+
+// The original ASCII output: "time x1 y1 x2 y2" in the position file and,
+// optionally, "time theta1 theta2" in the angle file. Numbers are written
+// with config.precision significant digits (0 = shortest round-trip)
+class TextTrajectoryWriter : public TrajectoryWriter {
+private:
+    AsciiEmitter positionFile;
+    AsciiEmitter angleFile;
+    bool writeAngles;
+    bool writeEnergy;
+
+public:
+    TextTrajectoryWriter() : writeAngles(false), writeEnergy(false) {}
+
+    // An empty angleFilename writes positions only. With ENERGY=columns the
+    // angle file (else the position file) gets kinetic, potential and total
+    // energy columns. Prints the reason and returns false when a file cannot
+    // be created
+    bool open(const std::string& positionFilename, const std::string& angleFilename,
+              const Config& config);
+
+    // Reopen the files of a checkpointed run, cut back to the checkpoint;
+    // false when a file cannot be opened
+    bool resume(const std::string& positionFilename, const std::string& angleFilename,
+                const Config& config, const Checkpoint& checkpoint);
+
+    void write(const Sample* samples, size_t count) override;
+    void checkpoint(Checkpoint& checkpoint) override;
+    bool close() override;
+};
+
+/*
+ * Output pipeline stage between the integrator and a TrajectoryWriter.
+ *
+ * The integrator appends samples into one of a few preallocated buffers.
+ * Full buffers travel over a lock-free SPSC ring to a writer thread that
+ * formats and writes them, then returns them over a second ring for reuse.
+ * The integrator only waits when every buffer is queued, i.e. when the disk
+ * or the formatter is slower than the simulation on average. A thread that
+ * has to wait sleeps on a WakeSignal instead of polling its ring.
+ */
+class AsyncTrajectoryWriter {
+private:
+    struct SampleBuffer {
+        std::vector<Sample> samples;
+        size_t count;
+    };
+
+    TrajectoryWriter& sink;
+    std::vector<SampleBuffer> buffers;
+    SpscRing<SampleBuffer*> filled;     // integrator -> writer thread
+    SpscRing<SampleBuffer*> recycled;   // writer thread -> integrator
+    SampleBuffer* current;
+    size_t submitted;                   // buffers handed to the writer thread
+    std::atomic<size_t> written;        // buffers the writer thread is done with
+    std::atomic<bool> finished;
+    WakeSignal dataReady;               // wakes the writer thread: filled or finished
+    WakeSignal spaceReady;              // wakes the integrator: recycled or written
+    std::thread thread;
+
+    // Hand the current buffer to the writer thread and take an empty one
+    void submit();
+    void writerLoop();
+
+public:
+    static const size_t DEFAULT_BUFFER_SAMPLES = 4096;
+    static const size_t DEFAULT_BUFFER_COUNT = 8;
+
+    AsyncTrajectoryWriter(TrajectoryWriter& sink,
+                          size_t bufferSamples = DEFAULT_BUFFER_SAMPLES,
+                          size_t bufferCount = DEFAULT_BUFFER_COUNT);
+    ~AsyncTrajectoryWriter();
+
+    AsyncTrajectoryWriter(const AsyncTrajectoryWriter&) = delete;
+    AsyncTrajectoryWriter& operator=(const AsyncTrajectoryWriter&) = delete;
+
+    void append(const Sample& sample) {
+        DP_PROFILE_SCOPE(OUTPUT_QUEUE);
+        DP_PROFILE_COUNT(SAMPLES, 1);
+        current->samples[current->count++] = sample;
+        if (current->count == current->samples.size()) submit();
+    }
+
+    // Sink interface of DoublePendulum::simulate
+    void operator()(const Sample& sample) { append(sample); }
+
+    // Wait until the sink has every sample appended so far, then let it
+    // record a checkpoint. Called from the integrator thread
+    void checkpoint(Checkpoint& checkpoint);
+
+    // Drain all queued samples into the sink and stop the writer thread.
+    // The sink itself stays open
+    void close();
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "AsciiEmitter.hpp"
+#include "Profiler.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+
+AsciiEmitter::AsciiEmitter()
+    : fd(-1), used(0), precision(0), bytesWritten(0), failed(false) {
+}
+
+AsciiEmitter::~AsciiEmitter() {
+    close();
+}
+
+bool AsciiEmitter::open(const std::string& filename, size_t bufferBytes) {
+    close();
+
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    buffer.resize(bufferBytes < MAX_NUMBER_CHARS ? MAX_NUMBER_CHARS : bufferBytes);
+    used = 0;
+    bytesWritten = 0;
+    failed = false;
+    return true;
+}
+
+bool AsciiEmitter::openAt(const std::string& filename, uint64_t offset, size_t bufferBytes) {
+    close();
+
+    fd = ::open(filename.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    if (::ftruncate(fd, offset) != 0 || ::lseek(fd, offset, SEEK_SET) < 0) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    buffer.resize(bufferBytes < MAX_NUMBER_CHARS ? MAX_NUMBER_CHARS : bufferBytes);
+    used = 0;
+    bytesWritten = offset;
+    failed = false;
+    return true;
+}
+
+char* AsciiEmitter::formatDouble(char* out, double v, int precision) {
+    char* end = out + MAX_NUMBER_CHARS;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::to_chars_result result = precision > 0
+        ? std::to_chars(out, end, v, std::chars_format::general, precision)
+        : std::to_chars(out, end, v);
+    return result.ptr;
+#else
+    // Older standard libraries: %.17g always reads back exactly, it is just
+    // not the shortest form
+    int n = std::snprintf(out, end - out, "%.*g", precision > 0 ? precision : 17, v);
+    return out + n;
+#endif
+}
+
+void AsciiEmitter::writeAll(const char* data, size_t length) {
+    DP_PROFILE_SCOPE(IO);
+    while (length > 0 && !failed) {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Report once; the run itself keeps going
+            std::cerr << "Error writing output file" << std::endl;
+            failed = true;
+            return;
+        }
+        data += n;
+        length -= n;
+        bytesWritten += n;
+        DP_PROFILE_COUNT(BYTES_WRITTEN, n);
+    }
+}
+
+void AsciiEmitter::flush() {
+    if (fd < 0 || used == 0) return;
+    writeAll(buffer.data(), used);
+    used = 0;
+}
+
+void AsciiEmitter::sync() {
+    if (fd < 0) return;
+    flush();
+    DP_PROFILE_SCOPE(IO);
+    ::fdatasync(fd);
+}
+
+bool AsciiEmitter::close() {
+    if (fd < 0) return !failed;
+    flush();
+    if (::close(fd) != 0) failed = true;
+    fd = -1;
+    return !failed;
+}
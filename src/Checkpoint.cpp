@@ -0,0 +1,94 @@
+#include "Checkpoint.hpp"
+#include "DoublePendulum.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void configValues(const Config& config, double values[11]) {
+    const double v[11] = {config.L1, config.L2, config.M1, config.M2, config.G,
+                          config.theta1, config.theta2, config.omega1, config.omega2,
+                          config.dt, config.totalTime};
+    std::memcpy(values, v, sizeof(v));
+}
+
+Checkpoint newCheckpoint(const Config& config) {
+    Checkpoint checkpoint;
+    std::memset(&checkpoint, 0, sizeof(checkpoint));
+    std::memcpy(checkpoint.magic, CHECKPOINT_MAGIC, sizeof(checkpoint.magic));
+    checkpoint.version = CHECKPOINT_VERSION;
+    configValues(config, checkpoint.config);
+    std::strncpy(checkpoint.method, config.method.c_str(), sizeof(checkpoint.method) - 1);
+    std::strncpy(checkpoint.outputFormat, config.outputFormat.c_str(), sizeof(checkpoint.outputFormat) - 1);
+    std::strncpy(checkpoint.outputMode, config.outputMode.c_str(), sizeof(checkpoint.outputMode) - 1);
+    std::strncpy(checkpoint.energyMode, config.energy.c_str(), sizeof(checkpoint.energyMode) - 1);
+    checkpoint.precision = config.precision;
+    checkpoint.outputEvery = config.outputEvery;
+    checkpoint.outputSamples = config.outputSamples;
+    checkpoint.outputInterval = config.outputInterval;
+    checkpoint.outputArc = config.outputArc;
+    return checkpoint;
+}
+
+bool writeCheckpoint(const std::string& filename, const Checkpoint& checkpoint) {
+    DP_PROFILE_SCOPE(IO);
+    const std::string temporary = filename + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    const char* data = reinterpret_cast<const char*>(&checkpoint);
+    size_t length = sizeof(checkpoint);
+    while (length > 0) {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd);
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+
+    // The record must be on disk before it replaces the previous one
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced && std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+Checkpoint readCheckpoint(const std::string& filename, const Config& config) {
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Cannot open checkpoint file: " + filename);
+    }
+    Checkpoint checkpoint;
+    size_t read = std::fread(&checkpoint, sizeof(checkpoint), 1, file);
+    std::fclose(file);
+
+    if (read != 1 || std::memcmp(checkpoint.magic, CHECKPOINT_MAGIC, sizeof(checkpoint.magic)) != 0 ||
+        checkpoint.version != CHECKPOINT_VERSION) {
+        throw std::runtime_error("Not a checkpoint file: " + filename);
+    }
+
+    // Bit-exact continuation needs the very same parameters and integrator
+    Checkpoint expected = newCheckpoint(config);
+    if (std::memcmp(checkpoint.config, expected.config, sizeof(expected.config)) != 0 ||
+        std::memcmp(checkpoint.method, expected.method, sizeof(expected.method)) != 0) {
+        throw std::runtime_error("Checkpoint " + filename + " was written with other parameters or METHOD");
+    }
+
+    // Appended rows must continue the layout and schedule of those on disk
+    if (std::memcmp(checkpoint.outputFormat, expected.outputFormat, sizeof(expected.outputFormat)) != 0 ||
+        std::memcmp(checkpoint.outputMode, expected.outputMode, sizeof(expected.outputMode)) != 0 ||
+        std::memcmp(checkpoint.energyMode, expected.energyMode, sizeof(expected.energyMode)) != 0 ||
+        checkpoint.precision != expected.precision ||
+        checkpoint.outputEvery != expected.outputEvery ||
+        checkpoint.outputSamples != expected.outputSamples ||
+        std::memcmp(&checkpoint.outputInterval, &expected.outputInterval, sizeof(double)) != 0 ||
+        std::memcmp(&checkpoint.outputArc, &expected.outputArc, sizeof(double)) != 0) {
+        throw std::runtime_error("Checkpoint " + filename + " was written with other OUTPUT_FORMAT, "
+                                 "OUTPUT_MODE, PRECISION or ENERGY settings");
+    }
+    return checkpoint;
+}
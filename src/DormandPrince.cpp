@@ -0,0 +1,163 @@
+#include "DormandPrince.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Butcher tableau (the system is autonomous, so the nodes c_i are not needed)
+static const double A21 = 1.0 / 5.0;
+static const double A31 = 3.0 / 40.0, A32 = 9.0 / 40.0;
+static const double A41 = 44.0 / 45.0, A42 = -56.0 / 15.0, A43 = 32.0 / 9.0;
+static const double A51 = 19372.0 / 6561.0, A52 = -25360.0 / 2187.0, A53 = 64448.0 / 6561.0,
+                    A54 = -212.0 / 729.0;
+static const double A61 = 9017.0 / 3168.0, A62 = -355.0 / 33.0, A63 = 46732.0 / 5247.0,
+                    A64 = 49.0 / 176.0, A65 = -5103.0 / 18656.0;
+static const double A71 = 35.0 / 384.0, A73 = 500.0 / 1113.0, A74 = 125.0 / 192.0,
+                    A75 = -2187.0 / 6784.0, A76 = 11.0 / 84.0;
+
+// Difference between the 5th and the embedded 4th order weights
+static const double E1 = 71.0 / 57600.0, E3 = -71.0 / 16695.0, E4 = 71.0 / 1920.0,
+                    E5 = -17253.0 / 339200.0, E6 = 22.0 / 525.0, E7 = -1.0 / 40.0;
+
+// Dense output weights
+static const double D1 = -12715105075.0 / 11282082432.0, D3 = 87487479700.0 / 32700410799.0,
+                    D4 = -10690763975.0 / 1880347072.0, D5 = 701980252875.0 / 199316789632.0,
+                    D6 = -1453857185.0 / 822651844.0, D7 = 69997945.0 / 29380423.0;
+
+DormandPrince::DormandPrince(const Config& cfg)
+    : config(cfg), params(cfg), atol(cfg.atol), rtol(cfg.rtol), t(0.0), h(cfg.dt), tPrev(0.0),
+      accepted(0), rejected(0) {
+    if (atol <= 0 && rtol <= 0) {
+        throw std::invalid_argument("ATOL or RTOL must be positive");
+    }
+    for (int i = 0; i < 4; i++) {
+        y[i] = k1[i] = 0.0;
+        for (int j = 0; j < 5; j++) cont[j][i] = 0.0;
+    }
+}
+
+void DormandPrince::derivatives(const double state[4], double dydt[4]) {
+    dydt[0] = state[2];
+    dydt[1] = state[3];
+    clampCounters.add(DoublePendulum::accelerationKernel(params, state[0], state[1], state[2], state[3],
+                                                         dydt[2], dydt[3]));
+}
+
+void DormandPrince::reset(double t0, const double state[4]) {
+    t = tPrev = t0;
+    for (int i = 0; i < 4; i++) {
+        y[i] = state[i];
+        cont[0][i] = state[i];
+        for (int j = 1; j < 5; j++) cont[j][i] = 0.0;
+    }
+    derivatives(y, k1);
+}
+
+void DormandPrince::step(double tEnd) {
+    double k2[4], k3[4], k4[4], k5[4], k6[4], k7[4];
+    double stage[4], y1[4];
+
+    while (true) {
+        bool last = t + h >= tEnd;
+        double hStep = last ? tEnd - t : h;
+
+        for (int i = 0; i < 4; i++) stage[i] = y[i] + hStep * A21 * k1[i];
+        derivatives(stage, k2);
+        for (int i = 0; i < 4; i++) stage[i] = y[i] + hStep * (A31 * k1[i] + A32 * k2[i]);
+        derivatives(stage, k3);
+        for (int i = 0; i < 4; i++) stage[i] = y[i] + hStep * (A41 * k1[i] + A42 * k2[i] + A43 * k3[i]);
+        derivatives(stage, k4);
+        for (int i = 0; i < 4; i++) {
+            stage[i] = y[i] + hStep * (A51 * k1[i] + A52 * k2[i] + A53 * k3[i] + A54 * k4[i]);
+        }
+        derivatives(stage, k5);
+        for (int i = 0; i < 4; i++) {
+            stage[i] = y[i] + hStep * (A61 * k1[i] + A62 * k2[i] + A63 * k3[i] + A64 * k4[i] + A65 * k5[i]);
+        }
+        derivatives(stage, k6);
+        for (int i = 0; i < 4; i++) {
+            y1[i] = y[i] + hStep * (A71 * k1[i] + A73 * k3[i] + A74 * k4[i] + A75 * k5[i] + A76 * k6[i]);
+        }
+        derivatives(y1, k7);
+
+        // Scaled RMS norm of the local error estimate
+        double err = 0.0;
+        for (int i = 0; i < 4; i++) {
+            double e = hStep * (E1 * k1[i] + E3 * k3[i] + E4 * k4[i] + E5 * k5[i] + E6 * k6[i] + E7 * k7[i]);
+            double scale = atol + rtol * std::max(std::abs(y[i]), std::abs(y1[i]));
+            err += (e / scale) * (e / scale);
+        }
+        err = std::sqrt(err / 4.0);
+
+        double factor = err > 0 ? 0.9 * std::pow(err, -0.2) : 5.0;
+        factor = std::max(0.2, std::min(5.0, factor));
+
+        if (err <= 1.0) {
+            // Dense output coefficients for [t, t + hStep]
+            for (int i = 0; i < 4; i++) {
+                double ydiff = y1[i] - y[i];
+                double bspl = hStep * k1[i] - ydiff;
+                cont[0][i] = y[i];
+                cont[1][i] = ydiff;
+                cont[2][i] = bspl;
+                cont[3][i] = ydiff - hStep * k7[i] - bspl;
+                cont[4][i] = hStep * (D1 * k1[i] + D3 * k3[i] + D4 * k4[i] + D5 * k5[i] + D6 * k6[i] + D7 * k7[i]);
+            }
+
+            tPrev = t;
+            t = last ? tEnd : t + hStep;
+            for (int i = 0; i < 4; i++) {
+                y[i] = y1[i];
+                k1[i] = k7[i];   // first same as last
+            }
+            // A step shortened to hit tEnd says nothing about the next size
+            if (!last || factor < 1.0) h = hStep * factor;
+            accepted++;
+            return;
+        }
+
+        h = hStep * std::min(1.0, factor);
+        rejected++;
+        if (t + h == t) {
+            throw std::runtime_error("Dormand-Prince step size underflow");
+        }
+    }
+}
+
+void DormandPrince::save(Checkpoint& checkpoint) const {
+    checkpoint.step = accepted;
+    checkpoint.rejected = rejected;
+    checkpoint.time = t;
+    checkpoint.stepper[0] = h;
+    checkpoint.stepper[1] = tPrev;
+    for (int i = 0; i < 4; i++) {
+        checkpoint.stepper[2 + i] = y[i];
+        checkpoint.stepper[6 + i] = k1[i];
+    }
+    checkpoint.clamps[0] = clampCounters.denominator;
+    checkpoint.clamps[1] = clampCounters.acceleration;
+}
+
+void DormandPrince::restore(const Checkpoint& checkpoint) {
+    accepted = checkpoint.step;
+    rejected = checkpoint.rejected;
+    t = checkpoint.time;
+    h = checkpoint.stepper[0];
+    tPrev = checkpoint.stepper[1];
+    for (int i = 0; i < 4; i++) {
+        y[i] = checkpoint.stepper[2 + i];
+        k1[i] = checkpoint.stepper[6 + i];
+        cont[0][i] = y[i];
+        for (int j = 1; j < 5; j++) cont[j][i] = 0.0;
+    }
+    clampCounters.denominator = checkpoint.clamps[0];
+    clampCounters.acceleration = checkpoint.clamps[1];
+}
+
+void DormandPrince::interpolate(double tau, double out[4]) const {
+    double span = t - tPrev;
+    double s = span > 0 ? (tau - tPrev) / span : 1.0;
+    double s1 = 1.0 - s;
+    for (int i = 0; i < 4; i++) {
+        out[i] = cont[0][i] + s * (cont[1][i] + s1 * (cont[2][i] + s * (cont[3][i] + s1 * cont[4][i])));
+    }
+}
@@ -1,9 +1,33 @@
 #include "DoublePendulum.hpp"
+#include "TrajectoryFile.hpp"
+#include "TrajectoryWriter.hpp"
+#include "OutputScheduler.hpp"
+#include "DormandPrince.hpp"
+#include "Stepper.hpp"
+#include "Energy.hpp"
+#include "SimulationLoop.hpp"
+#include <stdexcept>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
-DoublePendulum::DoublePendulum(const Config& cfg) : config(cfg) {
+DoublePendulum::CoefficientCache::CoefficientCache(const Config& cfg)
+    : kernel(cfg), dt(cfg.dt), twoDt(2 * cfg.dt) {}
+
+DoublePendulum::DoublePendulum(const Config& cfg)
+    : config(cfg), cache(cfg), clampPolicy(parseClampPolicy(cfg.onClamp)),
+      energyColumns(cfg.energy == "columns"), stopTime(0.0), acceptedSteps(0), rejectedSteps(0),
+      restart(), resuming(false) {
+    if (config.energy != "off" && config.energy != "stats" && !energyColumns) {
+        throw std::invalid_argument("Unknown ENERGY: " + config.energy);
+    }
+    if (energyColumns && config.outputFormat == "binary") {
+        throw std::invalid_argument("ENERGY=columns needs OUTPUT_FORMAT=text");
+    }
+    if (!config.checkpoint.empty() && config.checkpointEvery <= 0) {
+        throw std::invalid_argument("CHECKPOINT_EVERY must be positive");
+    }
+
     theta1 = normalizeAngle(config.theta1);
     theta2 = normalizeAngle(config.theta2);
     omega1 = config.omega1;
@@ -16,6 +40,13 @@ DoublePendulum::DoublePendulum(const Config& cfg) : config(cfg) {
     omega2_old = omega2;
 }
 
+ClampPolicy DoublePendulum::parseClampPolicy(const std::string& name) {
+    if (name == "continue") return CLAMP_CONTINUE;
+    if (name == "stop") return CLAMP_STOP;
+    if (name == "abort") return CLAMP_ABORT;
+    throw std::invalid_argument("Unknown ON_CLAMP: " + name);
+}
+
 double DoublePendulum::normalizeAngle(double angle) {
     // Normalize angle to [-π, π] range
     while (angle > M_PI) angle -= 2 * M_PI;
@@ -23,6 +54,39 @@ double DoublePendulum::normalizeAngle(double angle) {
     return angle;
 }
 
+void DoublePendulum::wrapAngle(double& theta, double& thetaOld) {
+    double wrapped = normalizeAngle(theta);
+    thetaOld += wrapped - theta;
+    theta = wrapped;
+}
+
+// Expand "linspace(a, b, n)" (n evenly spaced values from a to b) or
+// "logspace(a, b, n)" (10^x for x = linspace(a, b, n)) into values; false
+// when text is not a range, std::invalid_argument when it is malformed
+static bool parseRange(const std::string& text, std::vector<double>& values) {
+    bool logarithmic = text.compare(0, 9, "logspace(") == 0;
+    if (!logarithmic && text.compare(0, 9, "linspace(") != 0) return false;
+
+    double a, b;
+    long n;
+    char comma1, comma2, close;
+    std::istringstream in(text.substr(9));
+    if (!(in >> a >> comma1 >> b >> comma2 >> n >> close) ||
+        comma1 != ',' || comma2 != ',' || close != ')' || !(in >> std::ws).eof()) {
+        throw std::invalid_argument("Malformed range: " + text);
+    }
+    if (n < 1) {
+        throw std::invalid_argument("Range needs at least one value: " + text);
+    }
+
+    values.resize(n);
+    for (long i = 0; i < n; i++) {
+        double x = n > 1 ? a + (b - a) * i / (n - 1) : a;
+        values[i] = logarithmic ? std::pow(10.0, x) : x;
+    }
+    return true;
+}
+
 Config DoublePendulum::loadConfig(const std::string& filename) {
     Config cfg;
     std::ifstream file(filename);
@@ -64,6 +128,24 @@ Config DoublePendulum::loadConfig(const std::string& filename) {
         value.erase(0, value.find_first_not_of(" \t"));
         value.erase(value.find_last_not_of(" \t") + 1);
         
+        // A range makes the key a sweep axis; the scalar field holds its
+        // first value
+        std::vector<double> range;
+        if (parseRange(value, range)) {
+            if (key != "THETA1" && key != "THETA2" && key != "OMEGA1" && key != "OMEGA2") {
+                throw std::invalid_argument("Only THETA1, THETA2, OMEGA1 and OMEGA2 accept ranges, not " + key);
+            }
+            std::vector<SweepAxis>::iterator axis = cfg.sweep.begin();
+            while (axis != cfg.sweep.end() && axis->key != key) ++axis;
+            if (axis == cfg.sweep.end()) axis = cfg.sweep.insert(axis, SweepAxis{key, {}});
+            axis->values = range;
+            
+            std::ostringstream first;
+            first.precision(17);
+            first << range.front();
+            value = first.str();
+        }
+        
         if (key == "L1") cfg.L1 = std::stod(value);
         else if (key == "L2") cfg.L2 = std::stod(value);
         else if (key == "M1") cfg.M1 = std::stod(value);
@@ -75,6 +157,31 @@ Config DoublePendulum::loadConfig(const std::string& filename) {
         else if (key == "OMEGA2") cfg.omega2 = std::stod(value);
         else if (key == "DT") cfg.dt = std::stod(value);
         else if (key == "TOTAL_TIME") cfg.totalTime = std::stod(value);
+        else if (key == "METHOD") cfg.method = value;
+        else if (key == "ATOL") cfg.atol = std::stod(value);
+        else if (key == "RTOL") cfg.rtol = std::stod(value);
+        else if (key == "SIMD") cfg.simd = value;
+        else if (key == "OUTPUT_FORMAT") cfg.outputFormat = value;
+        else if (key == "PRECISION") cfg.precision = std::stoi(value);
+        else if (key == "OUTPUT_MODE") cfg.outputMode = value;
+        else if (key == "OUTPUT_EVERY") cfg.outputEvery = std::stoi(value);
+        else if (key == "OUTPUT_INTERVAL") cfg.outputInterval = std::stod(value);
+        else if (key == "OUTPUT_SAMPLES") cfg.outputSamples = std::stoi(value);
+        else if (key == "OUTPUT_ARC") cfg.outputArc = std::stod(value);
+        else if (key == "PROFILE_OUTPUT") cfg.profileOutput = value;
+        else if (key == "ON_CLAMP") cfg.onClamp = value;
+        else if (key == "CLAMP_LIMIT") cfg.clampLimit = std::stol(value);
+        else if (key == "THREADS") cfg.threads = std::stoi(value);
+        else if (key == "SWEEP_OUTPUT") cfg.sweepOutput = value;
+        else if (key == "LYAPUNOV") cfg.lyapunov = value;
+        else if (key == "LYAPUNOV_SEPARATION") cfg.lyapunovSeparation = std::stod(value);
+        else if (key == "LYAPUNOV_INTERVAL") cfg.lyapunovInterval = std::stod(value);
+        else if (key == "POINCARE") cfg.poincare = value;
+        else if (key == "POINCARE_ANGLE") cfg.poincareAngle = std::stod(value);
+        else if (key == "POINCARE_DIRECTION") cfg.poincareDirection = value;
+        else if (key == "ENERGY") cfg.energy = value;
+        else if (key == "CHECKPOINT") cfg.checkpoint = value;
+        else if (key == "CHECKPOINT_EVERY") cfg.checkpointEvery = std::stol(value);
     }
     
     file.close();
@@ -82,43 +189,7 @@ Config DoublePendulum::loadConfig(const std::string& filename) {
 }
 
 void DoublePendulum::calculateAcceleration(double& alpha1, double& alpha2) {
-    double L1 = config.L1, L2 = config.L2;
-    double M1 = config.M1, M2 = config.M2;
-    double g = config.G;
-    
-    double delta_theta = theta2 - theta1;
-    double cos_delta = cos(delta_theta);
-    double sin_delta = sin(delta_theta);
-    
-    double denom1 = (M1 + M2) * L1 - M2 * L1 * cos_delta * cos_delta;
-    double denom2 = (L2 / L1) * denom1;
-    
-    // Check for numerical stability - prevent division by very small numbers
-    const double MIN_DENOM = 1e-10;
-    if (std::abs(denom1) < MIN_DENOM) {
-        // Use a small but non-zero value to prevent explosion
-        denom1 = (denom1 >= 0) ? MIN_DENOM : -MIN_DENOM;
-    }
-    if (std::abs(denom2) < MIN_DENOM) {
-        denom2 = (denom2 >= 0) ? MIN_DENOM : -MIN_DENOM;
-    }
-    
-    // Calculate angular acceleration of first pendulum
-    alpha1 = (-M2 * L1 * omega1 * omega1 * sin_delta * cos_delta
-              + M2 * g * sin(theta2) * cos_delta
-              + M2 * L2 * omega2 * omega2 * sin_delta
-              - (M1 + M2) * g * sin(theta1)) / denom1;
-    
-    // Calculate angular acceleration of second pendulum
-    alpha2 = (-M2 * L2 * omega2 * omega2 * sin_delta * cos_delta
-              + (M1 + M2) * g * sin(theta1) * cos_delta
-              + (M1 + M2) * L1 * omega1 * omega1 * sin_delta
-              - (M1 + M2) * g * sin(theta2)) / denom2;
-    
-    // Clamp accelerations to prevent runaway values
-    const double MAX_ACCEL = 1000.0;  // Reasonable upper bound
-    alpha1 = std::max(-MAX_ACCEL, std::min(MAX_ACCEL, alpha1));
-    alpha2 = std::max(-MAX_ACCEL, std::min(MAX_ACCEL, alpha2));
+    clamps.add(accelerationKernel(cache.kernel, theta1, theta2, omega1, omega2, alpha1, alpha2));
 }
 
 /*
@@ -148,167 +219,188 @@ void DoublePendulum::verletStep() {
     // Update positions using Verlet algorithm
     // Mathematical formula: $\theta(t+\Delta t) = 2\theta(t) - \theta(t-\Delta t) + \alpha(t)(\Delta t)^2$
     // where $\alpha(t)$ is the angular acceleration at time $t$
-    double theta1_new = 2 * theta1 - theta1_old + alpha1 * config.dt * config.dt;
-    double theta2_new = 2 * theta2 - theta2_old + alpha2 * config.dt * config.dt;
+    // The products keep their order (no cached dt^2) so the result matches
+    // VerletStepper and PendulumEnsemble bit for bit
+    double theta1_new = 2 * theta1 - theta1_old + alpha1 * cache.dt * cache.dt;
+    double theta2_new = 2 * theta2 - theta2_old + alpha2 * cache.dt * cache.dt;
     
     // Update angular velocities (using central difference)
     // Mathematical formula: $\omega(t) = \frac{\theta(t+\Delta t) - \theta(t-\Delta t)}{2\Delta t}$
     // This provides better numerical stability than forward/backward differences
-    omega1 = (theta1_new - theta1_old) / (2 * config.dt);
-    omega2 = (theta2_new - theta2_old) / (2 * config.dt);
+    omega1 = (theta1_new - theta1_old) / cache.twoDt;
+    omega2 = (theta2_new - theta2_old) / cache.twoDt;
     
-    // Update positions
+    // Update positions; theta_old follows theta across the ±π seam
     theta1_old = theta1;
     theta2_old = theta2;
-    theta1 = normalizeAngle(theta1_new);
-    theta2 = normalizeAngle(theta2_new);
+    theta1 = theta1_new;
+    theta2 = theta2_new;
+    wrapAngle(theta1, theta1_old);
+    wrapAngle(theta2, theta2_old);
 }
 
 Point DoublePendulum::getPendulum1Position() {
-    return Point(config.L1 * sin(theta1), -config.L1 * cos(theta1));
+    double s1, c1;
+    fusedSinCos(theta1, s1, c1);
+    return Point(config.L1 * s1, -config.L1 * c1);
 }
 
 Point DoublePendulum::getPendulum2Position() {
     Point p1 = getPendulum1Position();
-    return Point(p1.x + config.L2 * sin(theta2), 
-                 p1.y - config.L2 * cos(theta2));
+    double s2, c2;
+    fusedSinCos(theta2, s2, c2);
+    return Point(p1.x + config.L2 * s2, 
+                 p1.y - config.L2 * c2);
 }
 
-void DoublePendulum::simulateAndOutputData(const std::string& dataFilename) {
-    double t = 0.0;
-    int steps = static_cast<int>(config.totalTime / config.dt);
-    
-    // Open data output file
-    std::ofstream dataFile(dataFilename);
-    if (!dataFile.is_open()) {
-        std::cerr << "Cannot create data file: " << dataFilename << std::endl;
-        return;
+Sample DoublePendulum::currentSample(double t, const PendulumTrig& trig, const PendulumTrig& energyTrig) {
+    DP_PROFILE_SCOPE(POSITIONS);
+    double x1 = config.L1 * trig.sin1, y1 = -config.L1 * trig.cos1;
+    Sample sample = {t, x1, y1, x1 + config.L2 * trig.sin2, y1 - config.L2 * trig.cos2,
+                     theta1, theta2, 0.0, 0.0};
+    if (energyColumns) {
+        Energy e = pendulumEnergy(config, energyTrig, omega1, omega2);
+        sample.kinetic = e.kinetic;
+        sample.potential = e.potential;
+    }
+    return sample;
+}
+
+void DoublePendulum::runSimulation(TrajectoryWriter& writer) {
+    if (resuming) {
+        std::cout << "Resuming from checkpoint at t = " << restart.time << " (step " << restart.step << ")"
+                  << std::endl;
+    }
+    std::cout << "Starting simulation..." << std::endl;
+    if (config.method != "dopri5") {
+        std::cout << "Total steps: " << fixedStepCount() << std::endl;
     }
     
-    // Write file header with configuration information
-    dataFile << "# Double Pendulum Simulation Data\n";
-    dataFile << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
-    dataFile << "# M1=" << config.M1 << " M2=" << config.M2 << "\n"; 
-    dataFile << "# G=" << config.G << " dt=" << config.dt << "\n";
-    dataFile << "# Data format: time x1 y1 x2 y2\n";
+    // Formatting and writing happen on the output thread
+    AsyncTrajectoryWriter output(writer);
+    EnergyMonitor energy(config);
+    const bool monitorEnergy = config.energy != "off";
     
-    // Progress tracking variables
-    int lastReportedProgress = -1;
+    integrate(output, monitorEnergy ? &energy : nullptr);
     
-    std::cout << "Starting simulation..." << std::endl;
-    std::cout << "Total steps: " << steps << std::endl;
+    // Wait for the output thread to write the remaining samples
+    output.close();
     
-    for (int i = 0; i < steps; i++) {
-        // Calculate and display progress percentage
-        int currentProgress = static_cast<int>((i * 100.0) / steps);
-        if (currentProgress > lastReportedProgress) {
-            lastReportedProgress = currentProgress;
-            // std::cout << "\rProgress: " << currentProgress << "%" << std::flush;
-        }
-        
-        if (i > 0) {  // Skip first step as it needs old values
-            verletStep();
-        } else {
-            // First step uses Euler method for initialization
-            // Mathematical formula: $\theta(t-\Delta t) = \theta(t) - \omega(t)\Delta t + \frac{1}{2}\alpha(t)(\Delta t)^2$
-            // This provides the "old" position needed for Verlet algorithm
-            double alpha1, alpha2;
-            calculateAcceleration(alpha1, alpha2);
-            theta1_old = theta1 - omega1 * config.dt + 0.5 * alpha1 * config.dt * config.dt;
-            theta2_old = theta2 - omega2 * config.dt + 0.5 * alpha2 * config.dt * config.dt;
-        }
-        
-        // Output data every 100 steps
-        if (i % 100 == 0) {
-            Point p1 = getPendulum1Position();
-            Point p2 = getPendulum2Position();
-            dataFile << t << " " << p1.x << " " << p1.y << " " << p2.x << " " << p2.y << "\n";
-        }
-        
-        t += config.dt;
+    if (!divergence.empty()) {
+        std::cout << "Warning: " << divergence << "; stopping" << std::endl;
+    }
+    if (config.method == "dopri5") {
+        std::cout << "Accepted steps: " << acceptedSteps << ", rejected steps: " << rejectedSteps << std::endl;
     }
     
-    // Display completion message
-    std::cout << "\rProgress: 100%" << std::endl;
-    std::cout << "Simulation completed! Data saved to: " << dataFilename << std::endl;
-    
-    dataFile.close();
+    // Display completion message, or how far a stopped run got
+    if (divergence.empty()) {
+        std::cout << "\rProgress: 100%" << std::endl;
+    } else {
+        std::cout << "\rProgress: " << static_cast<int>(100.0 * stopTime / config.totalTime)
+                  << "% (stopped at t = " << stopTime << ")" << std::endl;
+    }
+    std::cout << "Clamp events: " << clamps.total() << " (denominator " << clamps.denominator
+              << ", acceleration " << clamps.acceleration << ")" << std::endl;
+    if (monitorEnergy) {
+        energy.report(std::cout);
+    }
 }
 
-void DoublePendulum::simulateAndOutputAllData(const std::string& positionFilename, const std::string& angleFilename) {
-    double t = 0.0;
-    int steps = static_cast<int>(config.totalTime / config.dt);
+bool DoublePendulum::exceedsClampLimit(const ClampCounters& counters, double t) {
+    if (clampPolicy == CLAMP_CONTINUE || counters.total() <= config.clampLimit) {
+        return false;
+    }
     
-    // Open data output files
-    std::ofstream positionFile(positionFilename);
-    std::ofstream angleFile(angleFilename);
+    std::ostringstream message;
+    message << "run diverged, " << counters.total() << " clamp events by t = " << t;
+    if (clampPolicy == CLAMP_ABORT) {
+        throw std::runtime_error(message.str());
+    }
+    divergence = message.str();
+    stopTime = t;
+    return true;
+}
+
+void DoublePendulum::saveCheckpoint(Checkpoint& checkpoint, OutputScheduler& schedule,
+                                    AsyncTrajectoryWriter& output, EnergyMonitor* energy) {
+    schedule.save(checkpoint);
+    if (energy) {
+        energy->save(checkpoint);
+    }
     
-    if (!positionFile.is_open()) {
-        std::cerr << "Cannot create position file: " << positionFilename << std::endl;
+    // The output files must hold everything the checkpoint counts
+    output.checkpoint(checkpoint);
+    if (!writeCheckpoint(config.checkpoint, checkpoint)) {
+        // Report it; the run itself keeps going
+        std::cerr << "Cannot write checkpoint file: " << config.checkpoint << std::endl;
+    }
+}
+
+void DoublePendulum::resumeFromCheckpoint() {
+    if (config.checkpoint.empty()) {
+        throw std::invalid_argument("--resume needs a CHECKPOINT file");
+    }
+    restart = readCheckpoint(config.checkpoint, config);
+    resuming = true;
+}
+
+void DoublePendulum::simulateAndOutputData(const std::string& dataFilename) {
+    // Open data output file and write the header, or reopen it after a checkpoint
+    TextTrajectoryWriter dataFile;
+    bool opened = resuming ? dataFile.resume(dataFilename, "", config, restart)
+                           : dataFile.open(dataFilename, "", config);
+    if (!opened) {
         return;
     }
     
-    if (!angleFile.is_open()) {
-        std::cerr << "Cannot create angle file: " << angleFilename << std::endl;
+    runSimulation(dataFile);
+    if (!dataFile.close()) {
+        std::cerr << "Cannot write data file: " << dataFilename << std::endl;
         return;
     }
     
-    // Write file headers with configuration information
-    positionFile << "# Double Pendulum Simulation Data - Positions\n";
-    positionFile << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
-    positionFile << "# M1=" << config.M1 << " M2=" << config.M2 << "\n"; 
-    positionFile << "# G=" << config.G << " dt=" << config.dt << "\n";
-    positionFile << "# Data format: time x1 y1 x2 y2\n";
-    
-    angleFile << "# Double Pendulum Simulation Data - Angles\n";
-    angleFile << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
-    angleFile << "# M1=" << config.M1 << " M2=" << config.M2 << "\n"; 
-    angleFile << "# G=" << config.G << " dt=" << config.dt << "\n";
-    angleFile << "# Data format: time theta1 theta2\n";
-    
-    // Progress tracking variables
-    int lastReportedProgress = -1;
-    
-    std::cout << "Starting simulation..." << std::endl;
-    std::cout << "Total steps: " << steps << std::endl;
+    std::cout << "Simulation completed! Data saved to: " << dataFilename << std::endl;
+}
+
+void DoublePendulum::simulateAndOutputAllData(const std::string& positionFilename, const std::string& angleFilename) {
+    // Open data output files and write the headers, or reopen them after a checkpoint
+    TextTrajectoryWriter dataFiles;
+    bool opened = resuming ? dataFiles.resume(positionFilename, angleFilename, config, restart)
+                           : dataFiles.open(positionFilename, angleFilename, config);
+    if (!opened) {
+        return;
+    }
     
-    for (int i = 0; i < steps; i++) {
-        // Calculate and display progress percentage
-        int currentProgress = static_cast<int>((i * 100.0) / steps);
-        if (currentProgress > lastReportedProgress) {
-            lastReportedProgress = currentProgress;
-            // std::cout << "\rProgress: " << currentProgress << "%" << std::flush;
-        }
-        
-        if (i > 0) {  // Skip first step as it needs old values
-            verletStep();
-        } else {
-            // First step uses Euler method for initialization
-            // Mathematical formula: $\theta(t-\Delta t) = \theta(t) - \omega(t)\Delta t + \frac{1}{2}\alpha(t)(\Delta t)^2$
-            // This provides the "old" position needed for Verlet algorithm
-            double alpha1, alpha2;
-            calculateAcceleration(alpha1, alpha2);
-            theta1_old = theta1 - omega1 * config.dt + 0.5 * alpha1 * config.dt * config.dt;
-            theta2_old = theta2 - omega2 * config.dt + 0.5 * alpha2 * config.dt * config.dt;
-        }
-        
-        // Output data every 100 steps
-        if (i % 100 == 0) {
-            Point p1 = getPendulum1Position();
-            Point p2 = getPendulum2Position();
-            positionFile << t << " " << p1.x << " " << p1.y << " " << p2.x << " " << p2.y << "\n";
-            angleFile << t << " " << theta1 << " " << theta2 << "\n";
-        }
-        
-        t += config.dt;
+    runSimulation(dataFiles);
+    if (!dataFiles.close()) {
+        std::cerr << "Cannot write data files: " << positionFilename << ", " << angleFilename << std::endl;
+        return;
     }
     
-    // Display completion message
-    std::cout << "\rProgress: 100%" << std::endl;
     std::cout << "Simulation completed!" << std::endl;
     std::cout << "Position data saved to: " << positionFilename << std::endl;
     std::cout << "Angle data saved to: " << angleFilename << std::endl;
+}
+
+void DoublePendulum::simulateAndOutputBinaryData(const std::string& dataFilename) {
+    // Open data output file; the header carries the configuration
+    BinaryTrajectoryWriter dataFile;
+    if (resuming) {
+        if (!dataFile.resume(dataFilename, restart)) {
+            std::cerr << "Cannot resume data file: " << dataFilename << std::endl;
+            return;
+        }
+    } else if (!dataFile.open(dataFilename, config)) {
+        std::cerr << "Cannot create data file: " << dataFilename << std::endl;
+        return;
+    }
     
-    positionFile.close();
-    angleFile.close();
+    runSimulation(dataFile);
+    if (!dataFile.close()) {
+        std::cerr << "Cannot write data file: " << dataFilename << std::endl;
+        return;
+    }
+    
+    std::cout << "Simulation completed! Data saved to: " << dataFilename << std::endl;
 }
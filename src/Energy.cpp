@@ -0,0 +1,42 @@
+#include "Energy.hpp"
+#include <algorithm>
+
+EnergyMonitor::EnergyMonitor(const Config& cfg)
+    : scale((cfg.M1 + cfg.M2) * cfg.G * cfg.L1 + cfg.M2 * cfg.G * cfg.L2),
+      initial(0.0), minimum(0.0), maximum(0.0), last(0.0), count(0) {}
+
+void EnergyMonitor::add(double total) {
+    if (count == 0) {
+        initial = minimum = maximum = total;
+    } else {
+        minimum = std::min(minimum, total);
+        maximum = std::max(maximum, total);
+    }
+    last = total;
+    count++;
+}
+
+void EnergyMonitor::report(std::ostream& out) const {
+    if (count == 0) return;
+    double deviation = std::max(maximum - initial, initial - minimum);
+    out << "Energy: initial " << initial << ", min " << minimum << ", max " << maximum
+        << ", drift " << drift() << " (" << drift() / scale << " of well depth)" << std::endl;
+    out << "Energy: max deviation " << deviation << " (" << deviation / scale
+        << " of well depth) over " << count << " steps" << std::endl;
+}
+
+void EnergyMonitor::save(Checkpoint& checkpoint) const {
+    checkpoint.energyCount = count;
+    checkpoint.energy[0] = initial;
+    checkpoint.energy[1] = minimum;
+    checkpoint.energy[2] = maximum;
+    checkpoint.energy[3] = last;
+}
+
+void EnergyMonitor::restore(const Checkpoint& checkpoint) {
+    count = checkpoint.energyCount;
+    initial = checkpoint.energy[0];
+    minimum = checkpoint.energy[1];
+    maximum = checkpoint.energy[2];
+    last = checkpoint.energy[3];
+}
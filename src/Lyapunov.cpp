@@ -0,0 +1,235 @@
+#include "Lyapunov.hpp"
+#include "AsciiEmitter.hpp"
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+LyapunovEstimator::LyapunovEstimator(const Config& cfg)
+    : config(cfg), logGrowth(0.0), time(0.0) {
+    if (config.method == "dopri5") {
+        throw std::invalid_argument("LYAPUNOV needs a fixed-step METHOD, not dopri5");
+    }
+    if (!(config.lyapunovSeparation > 0.0) || !(config.lyapunovInterval > 0.0)) {
+        throw std::invalid_argument("LYAPUNOV_SEPARATION and LYAPUNOV_INTERVAL must be positive");
+    }
+    reference = createStepper(config);
+    shadow = createStepper(config);
+
+    referenceState.theta1 = DoublePendulum::normalizeAngle(config.theta1);
+    referenceState.theta2 = DoublePendulum::normalizeAngle(config.theta2);
+    referenceState.omega1 = config.omega1;
+    referenceState.omega2 = config.omega2;
+
+    // Offset every coordinate equally: $\delta = \frac{d_0}{2}(1, 1, 1, 1)$
+    double offset = 0.5 * config.lyapunovSeparation;
+    shadowState = referenceState;
+    shadowState.theta1 = DoublePendulum::normalizeAngle(referenceState.theta1 + offset);
+    shadowState.theta2 = DoublePendulum::normalizeAngle(referenceState.theta2 + offset);
+    shadowState.omega1 += offset;
+    shadowState.omega2 += offset;
+
+    reference->start(referenceState);
+    shadow->start(shadowState);
+}
+
+double LyapunovEstimator::separation() const {
+    double d1 = DoublePendulum::normalizeAngle(shadowState.theta1 - referenceState.theta1);
+    double d2 = DoublePendulum::normalizeAngle(shadowState.theta2 - referenceState.theta2);
+    double d3 = shadowState.omega1 - referenceState.omega1;
+    double d4 = shadowState.omega2 - referenceState.omega2;
+    return std::sqrt(d1 * d1 + d2 * d2 + d3 * d3 + d4 * d4);
+}
+
+double LyapunovEstimator::renormalize() {
+    double d = separation();
+    if (!std::isfinite(d) || d == 0.0) {
+        std::ostringstream message;
+        message << "Lyapunov separation is " << d << " at t = " << time << ", reduce LYAPUNOV_INTERVAL or DT";
+        throw std::runtime_error(message.str());
+    }
+
+    // Scale the whole difference, including the angles one step back that
+    // a two-step METHOD carries, so the shadow stays on a consistent state.
+    // Either trajectory may have crossed the ±π seam, so every angle
+    // difference is taken across it and the shadow is wrapped as a pair
+    double scale = config.lyapunovSeparation / d;
+    PendulumState& s = shadowState;
+    const PendulumState& r = referenceState;
+    s.theta1 = r.theta1 + DoublePendulum::normalizeAngle(s.theta1 - r.theta1) * scale;
+    s.theta2 = r.theta2 + DoublePendulum::normalizeAngle(s.theta2 - r.theta2) * scale;
+    s.omega1 = r.omega1 + (s.omega1 - r.omega1) * scale;
+    s.omega2 = r.omega2 + (s.omega2 - r.omega2) * scale;
+    s.theta1_old = r.theta1_old + DoublePendulum::normalizeAngle(s.theta1_old - r.theta1_old) * scale;
+    s.theta2_old = r.theta2_old + DoublePendulum::normalizeAngle(s.theta2_old - r.theta2_old) * scale;
+    DoublePendulum::wrapAngle(s.theta1, s.theta1_old);
+    DoublePendulum::wrapAngle(s.theta2, s.theta2_old);
+    return d / config.lyapunovSeparation;
+}
+
+ClampCounters LyapunovEstimator::getClampCounters() const {
+    ClampCounters clamps = reference->clamps();
+    clamps.add(shadow->clamps());
+    return clamps;
+}
+
+bool LyapunovEstimator::run(const std::string& filename) {
+    AsciiEmitter out;
+    if (!out.open(filename)) {
+        std::cerr << "Cannot create Lyapunov file: " << filename << std::endl;
+        return false;
+    }
+    out.setPrecision(config.precision);
+
+    std::ostringstream header;
+    header << "# Double Pendulum Largest Lyapunov Exponent (" << config.method << ")\n";
+    header << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
+    header << "# M1=" << config.M1 << " M2=" << config.M2 << "\n";
+    header << "# G=" << config.G << " dt=" << config.dt << " d0=" << config.lyapunovSeparation << "\n";
+    header << "# Data format: time lambda\n";
+    out.put(header.str());
+
+    long steps = static_cast<long>(config.totalTime / config.dt);
+    long interval = std::max(1L, std::lround(config.lyapunovInterval / config.dt));
+
+    std::cout << "Starting Lyapunov estimate..." << std::endl;
+    std::cout << "Total steps: " << steps << ", renormalized every " << interval << " steps" << std::endl;
+
+    for (long i = 1; i <= steps; i++) {
+        {
+            DP_PROFILE_SCOPE(PHYSICS);
+            DP_PROFILE_COUNT(STEPS, 2);
+            reference->step(referenceState);
+            shadow->step(shadowState);
+        }
+
+        if (i % interval == 0) {
+            time = i * config.dt;
+            logGrowth += std::log(renormalize());
+            out.put(time);
+            out.put(' ');
+            out.put(getExponent());
+            out.put('\n');
+        }
+    }
+    out.close();
+
+    ClampCounters clamps = getClampCounters();
+    std::cout << "Largest Lyapunov exponent: " << getExponent() << " 1/s" << std::endl;
+    std::cout << "Clamp events: " << clamps.total() << " (denominator " << clamps.denominator
+              << ", acceleration " << clamps.acceleration << ")" << std::endl;
+    std::cout << "Lyapunov data saved to: " << filename << std::endl;
+    return true;
+}
+
+LyapunovSpectrum::LyapunovSpectrum(const Config& cfg)
+    : config(cfg), phi(Mat4::identity()), time(0.0) {
+    if (!(config.lyapunovInterval > 0.0)) {
+        throw std::invalid_argument("LYAPUNOV_INTERVAL must be positive");
+    }
+    y[0] = config.theta1;
+    y[1] = config.theta2;
+    y[2] = config.omega1;
+    y[3] = config.omega2;
+    Unroll<4>::apply([&](int i) { logGrowth[i] = 0.0; });
+}
+
+void LyapunovSpectrum::derivatives(const double state[4], const Mat4& tangent,
+                                   double dy[4], Mat4& dtangent) {
+    double jac[2][4];
+    clamps.add(accelerationJacobian(config, state[0], state[1], state[2], state[3],
+                                    dy[2], dy[3], jac));
+    dy[0] = state[2];
+    dy[1] = state[3];
+
+    // J = [[0, I], [jac]]: angle rows copy the velocity rows
+    Unroll<4>::apply([&](int j) {
+        dtangent.a[0][j] = tangent.a[2][j];
+        dtangent.a[1][j] = tangent.a[3][j];
+        Unroll<2>::apply([&](int r) {
+            double sum = 0.0;
+            Unroll<4>::apply([&](int k) { sum += jac[r][k] * tangent.a[k][j]; });
+            dtangent.a[2 + r][j] = sum;
+        });
+    });
+}
+
+void LyapunovSpectrum::rk4Step(double h) {
+    double k1[4], k2[4], k3[4], k4[4], stage[4];
+    Mat4 m1, m2, m3, m4;
+
+    derivatives(y, phi, k1, m1);
+    Unroll<4>::apply([&](int i) { stage[i] = y[i] + 0.5 * h * k1[i]; });
+    derivatives(stage, addScaled(phi, 0.5 * h, m1), k2, m2);
+    Unroll<4>::apply([&](int i) { stage[i] = y[i] + 0.5 * h * k2[i]; });
+    derivatives(stage, addScaled(phi, 0.5 * h, m2), k3, m3);
+    Unroll<4>::apply([&](int i) { stage[i] = y[i] + h * k3[i]; });
+    derivatives(stage, addScaled(phi, h, m3), k4, m4);
+
+    Unroll<4>::apply([&](int i) {
+        y[i] += h / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+        Unroll<4>::apply([&](int j) {
+            phi.a[i][j] += h / 6.0 * (m1.a[i][j] + 2.0 * m2.a[i][j] + 2.0 * m3.a[i][j] + m4.a[i][j]);
+        });
+    });
+}
+
+bool LyapunovSpectrum::run(const std::string& filename) {
+    AsciiEmitter out;
+    if (!out.open(filename)) {
+        std::cerr << "Cannot create Lyapunov file: " << filename << std::endl;
+        return false;
+    }
+    out.setPrecision(config.precision);
+
+    std::ostringstream header;
+    header << "# Double Pendulum Lyapunov Spectrum (variational equations, RK4)\n";
+    header << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
+    header << "# M1=" << config.M1 << " M2=" << config.M2 << "\n";
+    header << "# G=" << config.G << " dt=" << config.dt << "\n";
+    header << "# Data format: time lambda1 lambda2 lambda3 lambda4\n";
+    out.put(header.str());
+
+    long steps = static_cast<long>(config.totalTime / config.dt);
+    long interval = std::max(1L, std::lround(config.lyapunovInterval / config.dt));
+
+    std::cout << "Starting Lyapunov spectrum..." << std::endl;
+    std::cout << "Total steps: " << steps << ", orthonormalized every " << interval << " steps" << std::endl;
+
+    double r[4];
+    for (long i = 1; i <= steps; i++) {
+        {
+            DP_PROFILE_SCOPE(PHYSICS);
+            DP_PROFILE_COUNT(STEPS, 1);
+            rk4Step(config.dt);
+        }
+
+        if (i % interval == 0) {
+            time = i * config.dt;
+            orthonormalize(phi, r);
+            if (!std::isfinite(r[0] * r[1] * r[2] * r[3]) || r[3] == 0.0) {
+                std::ostringstream message;
+                message << "Tangent vectors degenerated at t = " << time << ", reduce LYAPUNOV_INTERVAL or DT";
+                throw std::runtime_error(message.str());
+            }
+            out.put(time);
+            Unroll<4>::apply([&](int k) {
+                logGrowth[k] += std::log(r[k]);
+                out.put(' ');
+                out.put(getExponent(k));
+            });
+            out.put('\n');
+        }
+    }
+    out.close();
+
+    std::cout << "Lyapunov spectrum:";
+    for (int k = 0; k < 4; k++) std::cout << " " << getExponent(k);
+    std::cout << " 1/s" << std::endl;
+    std::cout << "Sum of exponents: "
+              << getExponent(0) + getExponent(1) + getExponent(2) + getExponent(3) << std::endl;
+    std::cout << "Clamp events: " << clamps.total() << " (denominator " << clamps.denominator
+              << ", acceleration " << clamps.acceleration << ")" << std::endl;
+    std::cout << "Lyapunov data saved to: " << filename << std::endl;
+    return true;
+}
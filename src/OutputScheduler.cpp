@@ -0,0 +1,24 @@
+#include "OutputScheduler.hpp"
+#include <stdexcept>
+
+OutputScheduler::OutputScheduler(const Config& cfg)
+    : every(cfg.outputEvery), interval(cfg.outputInterval), arc(cfg.outputArc),
+      L1(cfg.L1), L2(cfg.L2), dt(cfg.dt), nextIndex(1), travelled(0.0) {
+    if (cfg.outputMode == "steps") {
+        mode = STEPS;
+        if (every <= 0) throw std::invalid_argument("OUTPUT_EVERY must be positive");
+    } else if (cfg.outputMode == "interval") {
+        mode = INTERVAL;
+        if (interval <= 0) throw std::invalid_argument("OUTPUT_INTERVAL must be positive");
+    } else if (cfg.outputMode == "count") {
+        mode = COUNT;
+        if (cfg.outputSamples <= 0) throw std::invalid_argument("OUTPUT_SAMPLES must be positive");
+        // The first sample sits at t = 0, the rest split the run evenly
+        interval = cfg.totalTime / cfg.outputSamples;
+    } else if (cfg.outputMode == "adaptive") {
+        mode = ADAPTIVE;
+        if (arc <= 0) throw std::invalid_argument("OUTPUT_ARC must be positive");
+    } else {
+        throw std::invalid_argument("Unknown OUTPUT_MODE: " + cfg.outputMode);
+    }
+}
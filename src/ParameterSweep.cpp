@@ -0,0 +1,184 @@
+#include "ParameterSweep.hpp"
+#include "AsciiEmitter.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+ParameterSweep::ParameterSweep(const Config& cfg)
+    : config(cfg), ensemble(cfg), flipTimes(cfg.sweepOutput == "flip-time"), cellCount(1) {
+    if (config.method != "verlet") {
+        throw std::invalid_argument("Parameter sweeps integrate with METHOD=verlet, not " + config.method);
+    }
+    if (!flipTimes && config.sweepOutput != "final") {
+        throw std::invalid_argument("Unknown SWEEP_OUTPUT: " + config.sweepOutput);
+    }
+    if (flipTimes && config.sweep.size() != 2) {
+        throw std::invalid_argument("SWEEP_OUTPUT=flip-time needs ranges on exactly two keys");
+    }
+
+    strides.resize(config.sweep.size());
+    for (size_t a = config.sweep.size(); a-- > 0;) {
+        strides[a] = cellCount;
+        cellCount *= config.sweep[a].values.size();
+    }
+
+    ensemble.setStopOnFlip(flipTimes);
+    ensemble.reserve(cellCount);
+    members.resize(cellCount);
+    double state[4];
+    for (size_t i = 0; i < cellCount; i++) {
+        initialConditions(i, state);
+        if (flipTimes && !canFlip(config, state)) {
+            members[i] = NO_MEMBER;
+            continue;
+        }
+        members[i] = ensemble.addMember(state[0], state[1], state[2], state[3]);
+    }
+}
+
+void ParameterSweep::initialConditions(size_t i, double state[4]) const {
+    state[0] = config.theta1;
+    state[1] = config.theta2;
+    state[2] = config.omega1;
+    state[3] = config.omega2;
+
+    for (size_t a = 0; a < config.sweep.size(); a++) {
+        const SweepAxis& axis = config.sweep[a];
+        double value = axis.values[(i / strides[a]) % axis.values.size()];
+        if (axis.key == "THETA1") state[0] = value;
+        else if (axis.key == "THETA2") state[1] = value;
+        else if (axis.key == "OMEGA1") state[2] = value;
+        else if (axis.key == "OMEGA2") state[3] = value;
+    }
+}
+
+bool ParameterSweep::canFlip(const Config& cfg, const double state[4]) {
+    // $E = \frac{1}{2}(m_1+m_2)L_1^2\omega_1^2 + \frac{1}{2}m_2 L_2^2\omega_2^2
+    //      + m_2 L_1 L_2\omega_1\omega_2\cos(\theta_1-\theta_2)
+    //      - (m_1+m_2) g L_1\cos\theta_1 - m_2 g L_2\cos\theta_2$
+    // A flip needs at least the potential energy of one arm upright with
+    // the other hanging down
+    double kinetic = 0.5 * (cfg.M1 + cfg.M2) * cfg.L1 * cfg.L1 * state[2] * state[2]
+                   + 0.5 * cfg.M2 * cfg.L2 * cfg.L2 * state[3] * state[3]
+                   + cfg.M2 * cfg.L1 * cfg.L2 * state[2] * state[3] * std::cos(state[0] - state[1]);
+    double potential = -(cfg.M1 + cfg.M2) * cfg.G * cfg.L1 * std::cos(state[0])
+                       - cfg.M2 * cfg.G * cfg.L2 * std::cos(state[1]);
+
+    double upper = (cfg.M1 + cfg.M2) * cfg.G * cfg.L1 - cfg.M2 * cfg.G * cfg.L2;
+    double lower = -(cfg.M1 + cfg.M2) * cfg.G * cfg.L1 + cfg.M2 * cfg.G * cfg.L2;
+    return kinetic + potential >= std::min(upper, lower);
+}
+
+void ParameterSweep::run(ThreadPool& pool) {
+    int steps = static_cast<int>(config.totalTime / config.dt);
+
+    std::cout << "Starting sweep: " << size() << " cells";
+    for (const SweepAxis& axis : config.sweep) {
+        std::cout << (&axis == &config.sweep.front() ? " (" : " x ")
+                  << axis.key << " " << axis.values.size();
+    }
+    std::cout << "), " << pool.size() << " threads" << std::endl;
+    if (flipTimes) {
+        std::cout << "Cells that cannot flip: " << size() - ensemble.size() << std::endl;
+    }
+    std::cout << "Total steps: " << steps << std::endl;
+
+    ensemble.initialize();
+    ensemble.advance(steps, pool);
+
+    if (flipTimes) {
+        std::cout << "Flipped cells: " << ensemble.flippedCount() << std::endl;
+    }
+    std::cout << "Clamp events: " << ensemble.totalClampCount()
+              << ", diverged members: " << ensemble.divergedCount() << std::endl;
+}
+
+bool ParameterSweep::write(const std::string& filename) const {
+    return flipTimes ? writeFlipTimes(filename) : writeFinal(filename);
+}
+
+bool ParameterSweep::writeFinal(const std::string& filename) const {
+    AsciiEmitter out;
+    if (!out.open(filename)) {
+        std::cerr << "Cannot create sweep file: " << filename << std::endl;
+        return false;
+    }
+    out.setPrecision(config.precision);
+
+    std::ostringstream header;
+    header << "# Double Pendulum Parameter Sweep\n";
+    header << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
+    header << "# M1=" << config.M1 << " M2=" << config.M2 << "\n";
+    header << "# G=" << config.G << " dt=" << config.dt << " T=" << config.totalTime << "\n";
+    header << "# Data format: theta1_0 theta2_0 omega1_0 omega2_0 theta1 theta2 omega1 omega2 clamps diverged\n";
+    out.put(header.str());
+
+    double state[4];
+    for (size_t i = 0; i < size(); i++) {
+        size_t m = members[i];
+        initialConditions(i, state);
+        for (double v : state) {
+            out.put(v);
+            out.put(' ');
+        }
+        out.put(ensemble.getTheta1(m));
+        out.put(' ');
+        out.put(ensemble.getTheta2(m));
+        out.put(' ');
+        out.put(ensemble.getOmega1(m));
+        out.put(' ');
+        out.put(ensemble.getOmega2(m));
+        out.put(' ');
+        out.put(std::to_string(ensemble.getClampCount(m)));
+        out.put(' ');
+        out.put(ensemble.isDiverged(m) ? '1' : '0');
+        out.put('\n');
+    }
+    out.close();
+
+    std::cout << "Sweep results saved to: " << filename << std::endl;
+    return true;
+}
+
+bool ParameterSweep::writeFlipTimes(const std::string& filename) const {
+    // Portable float map: text header, then 32-bit floats row by row from
+    // the bottom of the image; a negative scale marks little-endian data.
+    // Rows follow the first axis, so its first value is the bottom row
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot create flip-time image: " << filename << std::endl;
+        return false;
+    }
+
+    const uint16_t probe = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &probe, 1);
+
+    size_t width = config.sweep[1].values.size();
+    size_t height = config.sweep[0].values.size();
+    std::fprintf(file, "Pf\n%zu %zu\n%s\n", width, height, firstByte ? "-1.0" : "1.0");
+
+    std::vector<float> row(width);
+    bool ok = true;
+    for (size_t y = 0; y < height && ok; y++) {
+        for (size_t x = 0; x < width; x++) {
+            size_t m = members[y * width + x];
+            double t = m == NO_MEMBER ? NAN : ensemble.getFlipTime(m);
+            row[x] = std::isnan(t) ? -1.0f : static_cast<float>(t);
+        }
+        ok = std::fwrite(row.data(), sizeof(float), width, file) == width;
+    }
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::cerr << "Cannot write flip-time image: " << filename << std::endl;
+        return false;
+    }
+
+    std::cout << "Flip-time image (" << width << "x" << height << ") saved to: " << filename << std::endl;
+    return true;
+}
@@ -0,0 +1,212 @@
+#include "PendulumEnsemble.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+PendulumEnsemble::PendulumEnsemble(const Config& cfg)
+    : config(cfg), clampPolicy(DoublePendulum::parseClampPolicy(cfg.onClamp)),
+      stopOnFlip(false), stepsTaken(0) {
+    simdLevel = parseSimdLevel(config.simd);
+    accelerationBatch = selectAccelerationKernel(simdLevel);
+}
+
+void PendulumEnsemble::reserve(size_t n) {
+    theta1.reserve(n);
+    theta2.reserve(n);
+    omega1.reserve(n);
+    omega2.reserve(n);
+    theta1_old.reserve(n);
+    theta2_old.reserve(n);
+    clampCount.reserve(n);
+    status.reserve(n);
+    flipTime.reserve(n);
+    memberSlot.reserve(n);
+    slotMember.reserve(n);
+}
+
+size_t PendulumEnsemble::addMember(double t1, double t2, double w1, double w2) {
+    theta1.push_back(DoublePendulum::normalizeAngle(t1));
+    theta2.push_back(DoublePendulum::normalizeAngle(t2));
+    omega1.push_back(w1);
+    omega2.push_back(w2);
+    theta1_old.push_back(theta1.back());
+    theta2_old.push_back(theta2.back());
+    clampCount.push_back(0);
+    status.push_back(LIVE);
+    flipTime.push_back(NAN);
+    memberSlot.push_back(theta1.size() - 1);
+    slotMember.push_back(theta1.size() - 1);
+    return theta1.size() - 1;
+}
+
+void PendulumEnsemble::initialize() {
+    const double dt = config.dt;
+    stepsTaken = 0;
+    for (size_t i = 0; i < size(); i++) {
+        double alpha1, alpha2;
+        unsigned flags = DoublePendulum::accelerationKernel(config, theta1[i], theta2[i], omega1[i], omega2[i],
+                                                            alpha1, alpha2);
+        clampCount[i] += ClampCounters::events(flags);
+        theta1_old[i] = theta1[i] - omega1[i] * dt + 0.5 * alpha1 * dt * dt;
+        theta2_old[i] = theta2[i] - omega2[i] * dt + 0.5 * alpha2 * dt * dt;
+    }
+}
+
+size_t PendulumEnsemble::stepRange(size_t begin, size_t end, long step) {
+    DP_PROFILE_SCOPE(PHYSICS);
+    DP_PROFILE_COUNT(STEPS, end - begin);
+    const double dt = config.dt;
+    double* t1 = theta1.data();
+    double* t2 = theta2.data();
+    double* w1 = omega1.data();
+    double* w2 = omega2.data();
+    double* t1_old = theta1_old.data();
+    double* t2_old = theta2_old.data();
+    const long clampLimit = config.clampLimit;
+    size_t live = 0;
+
+    double alpha1[BLOCK_SIZE], alpha2[BLOCK_SIZE];
+    unsigned flags[BLOCK_SIZE];
+    for (size_t blockBegin = begin; blockBegin < end; blockBegin += BLOCK_SIZE) {
+        size_t n = std::min(end - blockBegin, BLOCK_SIZE);
+        accelerationBatch(config, t1 + blockBegin, t2 + blockBegin, w1 + blockBegin, w2 + blockBegin,
+                          alpha1, alpha2, flags, n);
+
+        // Same arithmetic, in the same order, as DoublePendulum::verletStep so
+        // that with the scalar kernel a member reproduces a single-pendulum
+        // run bit for bit
+        for (size_t k = 0; k < n; k++) {
+            size_t i = blockBegin + k;
+            if (status[i] != LIVE) continue;
+
+            // Counted like ClampCounters::total() of a single run
+            if (flags[k]) {
+                clampCount[i] += ClampCounters::events(flags[k]);
+                if (clampCount[i] > clampLimit && clampPolicy != CLAMP_CONTINUE) {
+                    if (clampPolicy == CLAMP_ABORT) {
+                        throw std::runtime_error("ensemble member " + std::to_string(slotMember[i]) + " diverged, " +
+                                                 std::to_string(clampCount[i]) + " clamp events");
+                    }
+                    status[i] = DIVERGED;
+                    continue;
+                }
+            }
+
+            double theta1_new = 2 * t1[i] - t1_old[i] + alpha1[k] * dt * dt;
+            double theta2_new = 2 * t2[i] - t2_old[i] + alpha2[k] * dt * dt;
+
+            // An arm flips when it leaves [-π, π] before normalization;
+            // the member keeps its state before the flip
+            if (stopOnFlip && (std::abs(theta1_new) > M_PI || std::abs(theta2_new) > M_PI)) {
+                double fraction = 1.0;
+                if (std::abs(theta1_new) > M_PI) {
+                    fraction = (M_PI - std::abs(t1[i])) / (std::abs(theta1_new) - std::abs(t1[i]));
+                }
+                if (std::abs(theta2_new) > M_PI) {
+                    fraction = std::min(fraction, (M_PI - std::abs(t2[i])) / (std::abs(theta2_new) - std::abs(t2[i])));
+                }
+                flipTime[i] = (step - 1 + fraction) * dt;
+                status[i] = FLIPPED;
+                continue;
+            }
+
+            w1[i] = (theta1_new - t1_old[i]) / (2 * dt);
+            w2[i] = (theta2_new - t2_old[i]) / (2 * dt);
+
+            t1_old[i] = t1[i];
+            t2_old[i] = t2[i];
+            t1[i] = theta1_new;
+            t2[i] = theta2_new;
+            DoublePendulum::wrapAngle(t1[i], t1_old[i]);
+            DoublePendulum::wrapAngle(t2[i], t2_old[i]);
+            live++;
+        }
+    }
+    return live;
+}
+
+void PendulumEnsemble::step() {
+    stepRange(0, size(), ++stepsTaken);
+}
+
+void PendulumEnsemble::swapSlots(size_t a, size_t b) {
+    std::swap(theta1[a], theta1[b]);
+    std::swap(theta2[a], theta2[b]);
+    std::swap(omega1[a], omega1[b]);
+    std::swap(omega2[a], omega2[b]);
+    std::swap(theta1_old[a], theta1_old[b]);
+    std::swap(theta2_old[a], theta2_old[b]);
+    std::swap(clampCount[a], clampCount[b]);
+    std::swap(status[a], status[b]);
+    std::swap(flipTime[a], flipTime[b]);
+    std::swap(slotMember[a], slotMember[b]);
+    memberSlot[slotMember[a]] = a;
+    memberSlot[slotMember[b]] = b;
+}
+
+size_t PendulumEnsemble::compact() {
+    // Swap stopped members from the front with live ones from the back;
+    // only slots that change hands are touched
+    size_t front = 0, back = size();
+    for (;;) {
+        while (front < back && status[front] == LIVE) front++;
+        while (front < back && status[back - 1] != LIVE) back--;
+        if (front == back) return front;
+        swapSlots(front++, --back);
+    }
+}
+
+void PendulumEnsemble::advanceLive(int steps, ThreadPool* pool) {
+    // Without a stop condition every member stays live: one round, no compaction
+    bool canStop = stopOnFlip || clampPolicy == CLAMP_STOP;
+    int round = canStop ? COMPACT_INTERVAL : steps;
+
+    for (int done = 0; done < steps; done += round) {
+        size_t live = canStop ? compact() : size();
+        if (live == 0) break;
+
+        // Members are independent, so run all steps of the round on one
+        // cache-resident block before moving on instead of sweeping the
+        // whole ensemble every step
+        int count = std::min(round, steps - done);
+        long first = stepsTaken + done;
+        auto runBlock = [&](size_t block) {
+            size_t begin = block * BLOCK_SIZE;
+            size_t end = std::min(live, begin + BLOCK_SIZE);
+            for (int s = 1; s <= count; s++) {
+                if (stepRange(begin, end, first + s) == 0) break;
+            }
+        };
+
+        size_t blocks = (live + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (pool) {
+            pool->parallelFor(blocks, runBlock);
+        } else {
+            for (size_t block = 0; block < blocks; block++) runBlock(block);
+        }
+    }
+    stepsTaken += steps;
+}
+
+void PendulumEnsemble::advance(int steps) {
+    advanceLive(steps, nullptr);
+}
+
+void PendulumEnsemble::advance(int steps, ThreadPool& pool) {
+    advanceLive(steps, &pool);
+}
+
+uint64_t PendulumEnsemble::totalClampCount() const {
+    uint64_t total = 0;
+    for (uint32_t count : clampCount) total += count;
+    return total;
+}
+
+size_t PendulumEnsemble::divergedCount() const {
+    return std::count(status.begin(), status.end(), static_cast<uint8_t>(DIVERGED));
+}
+
+size_t PendulumEnsemble::flippedCount() const {
+    return std::count(status.begin(), status.end(), static_cast<uint8_t>(FLIPPED));
+}
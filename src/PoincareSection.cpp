@@ -0,0 +1,182 @@
+#include "PoincareSection.hpp"
+#include "DormandPrince.hpp"
+#include "Stepper.hpp"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+// Bisection halvings of the crossing interval, enough to reach the
+// resolution of a double
+static const int REFINE_ITERATIONS = 60;
+
+// Cubic Hermite interpolant on s in [0, 1] with values p0, p1 and slopes
+// m0, m1 (per unit of time, step length h)
+static double hermite(double p0, double p1, double m0, double m1, double h, double s) {
+    double s2 = s * s, s3 = s2 * s;
+    return (2.0 * s3 - 3.0 * s2 + 1.0) * p0 + (s3 - 2.0 * s2 + s) * h * m0
+         + (-2.0 * s3 + 3.0 * s2) * p1 + (s3 - s2) * h * m1;
+}
+
+PoincareSection::PoincareSection(const Config& cfg)
+    : config(cfg), crossings(0) {
+    if (config.poincare == "theta1") index = 0;
+    else if (config.poincare == "theta2") index = 1;
+    else throw std::invalid_argument("Unknown POINCARE: " + config.poincare);
+
+    if (config.poincareDirection == "positive") direction = 1;
+    else if (config.poincareDirection == "negative") direction = -1;
+    else if (config.poincareDirection == "both") direction = 0;
+    else throw std::invalid_argument("Unknown POINCARE_DIRECTION: " + config.poincareDirection);
+}
+
+double PoincareSection::offset(double theta) const {
+    return DoublePendulum::normalizeAngle(theta - config.poincareAngle);
+}
+
+bool PoincareSection::crosses(double a0, double a1) const {
+    bool up = a0 < 0.0 && a1 >= 0.0;
+    bool down = a0 > 0.0 && a1 <= 0.0;
+    return direction > 0 ? up : (direction < 0 ? down : up || down);
+}
+
+void PoincareSection::emit(double t, const double state[4]) {
+    out.put(t);
+    out.put(' ');
+    out.put(DoublePendulum::normalizeAngle(state[0]));
+    out.put(' ');
+    out.put(DoublePendulum::normalizeAngle(state[1]));
+    out.put(' ');
+    out.put(state[2]);
+    out.put(' ');
+    out.put(state[3]);
+    out.put('\n');
+    crossings++;
+}
+
+void PoincareSection::runFixedStep() {
+    std::unique_ptr<Stepper> stepper = createStepper(config);
+    const double dt = config.dt;
+    long steps = static_cast<long>(config.totalTime / dt);
+    std::cout << "Total steps: " << steps << std::endl;
+
+    PendulumState state = {};
+    state.theta1 = DoublePendulum::normalizeAngle(config.theta1);
+    state.theta2 = DoublePendulum::normalizeAngle(config.theta2);
+    state.omega1 = config.omega1;
+    state.omega2 = config.omega2;
+    stepper->start(state);
+
+    for (long i = 1; i <= steps; i++) {
+        PendulumState before = state;
+        {
+            DP_PROFILE_SCOPE(PHYSICS);
+            DP_PROFILE_COUNT(STEPS, 1);
+            stepper->step(state);
+        }
+
+        // Angle changes within the step, continued across the seam
+        double d1 = DoublePendulum::normalizeAngle(state.theta1 - before.theta1);
+        double d2 = DoublePendulum::normalizeAngle(state.theta2 - before.theta2);
+        double a0 = offset(index == 0 ? before.theta1 : before.theta2);
+        double a1 = a0 + (index == 0 ? d1 : d2);
+        if (!crosses(a0, a1)) continue;
+
+        const double m0 = index == 0 ? before.omega1 : before.omega2;
+        const double m1 = index == 0 ? state.omega1 : state.omega2;
+        double lo = 0.0, hi = 1.0;
+        for (int k = 0; k < REFINE_ITERATIONS; k++) {
+            double mid = 0.5 * (lo + hi);
+            double a = hermite(a0, a1, m0, m1, dt, mid);
+            if ((a < 0.0) == (a0 < 0.0)) lo = mid;
+            else hi = mid;
+        }
+        double s = 0.5 * (lo + hi);
+
+        // Angular velocities interpolate with the accelerations as slopes
+        double alpha0[2], alpha1[2];
+        DoublePendulum::accelerationKernel(config, before.theta1, before.theta2, before.omega1, before.omega2,
+                                           alpha0[0], alpha0[1]);
+        DoublePendulum::accelerationKernel(config, state.theta1, state.theta2, state.omega1, state.omega2,
+                                           alpha1[0], alpha1[1]);
+        double crossing[4] = {
+            before.theta1 + hermite(0.0, d1, before.omega1, state.omega1, dt, s),
+            before.theta2 + hermite(0.0, d2, before.omega2, state.omega2, dt, s),
+            hermite(before.omega1, state.omega1, alpha0[0], alpha1[0], dt, s),
+            hermite(before.omega2, state.omega2, alpha0[1], alpha1[1], dt, s)
+        };
+        emit((i - 1 + s) * dt, crossing);
+    }
+
+    const ClampCounters& clamps = stepper->clamps();
+    std::cout << "Clamp events: " << clamps.total() << " (denominator " << clamps.denominator
+              << ", acceleration " << clamps.acceleration << ")" << std::endl;
+}
+
+void PoincareSection::runDormandPrince() {
+    DormandPrince stepper(config);
+    double y[4] = {DoublePendulum::normalizeAngle(config.theta1), DoublePendulum::normalizeAngle(config.theta2),
+                   config.omega1, config.omega2};
+    stepper.reset(0.0, y);
+
+    double before[4], crossing[4];
+    while (stepper.time() < config.totalTime) {
+        std::copy(stepper.state(), stepper.state() + 4, before);
+        {
+            DP_PROFILE_SCOPE(PHYSICS);
+            DP_PROFILE_COUNT(STEPS, 1);
+            stepper.step(config.totalTime);
+        }
+
+        // The integrator does not wrap its angles, differences are continuous
+        double a0 = offset(before[index]);
+        double a1 = a0 + (stepper.state()[index] - before[index]);
+        if (!crosses(a0, a1)) continue;
+
+        double lo = stepper.previousTime(), hi = stepper.time();
+        for (int k = 0; k < REFINE_ITERATIONS; k++) {
+            double mid = 0.5 * (lo + hi);
+            stepper.interpolate(mid, crossing);
+            double a = a0 + (crossing[index] - before[index]);
+            if ((a < 0.0) == (a0 < 0.0)) lo = mid;
+            else hi = mid;
+        }
+        double t = 0.5 * (lo + hi);
+        stepper.interpolate(t, crossing);
+        emit(t, crossing);
+    }
+
+    std::cout << "Accepted steps: " << stepper.acceptedSteps()
+              << ", rejected steps: " << stepper.rejectedSteps() << std::endl;
+    const ClampCounters& clamps = stepper.clamps();
+    std::cout << "Clamp events: " << clamps.total() << " (denominator " << clamps.denominator
+              << ", acceleration " << clamps.acceleration << ")" << std::endl;
+}
+
+bool PoincareSection::run(const std::string& filename) {
+    if (!out.open(filename)) {
+        std::cerr << "Cannot create Poincare section file: " << filename << std::endl;
+        return false;
+    }
+    out.setPrecision(config.precision);
+
+    std::ostringstream header;
+    header << "# Double Pendulum Poincare Section (" << config.poincare << " = " << config.poincareAngle
+           << ", " << config.poincareDirection << " crossings, " << config.method << ")\n";
+    header << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
+    header << "# M1=" << config.M1 << " M2=" << config.M2 << "\n";
+    header << "# G=" << config.G << " dt=" << config.dt << "\n";
+    header << "# Data format: time theta1 theta2 omega1 omega2\n";
+    out.put(header.str());
+
+    std::cout << "Starting Poincare section..." << std::endl;
+    if (config.method == "dopri5") {
+        runDormandPrince();
+    } else {
+        runFixedStep();
+    }
+    out.close();
+
+    std::cout << "Crossings: " << crossings << std::endl;
+    std::cout << "Poincare section saved to: " << filename << std::endl;
+    return true;
+}
@@ -0,0 +1,118 @@
+#include "Profiler.hpp"
+
+#ifdef DP_PROFILE
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace profile {
+
+static const char* const PHASE_NAMES[PHASE_COUNT] = {
+    "physics", "positions", "output_queue", "formatting", "io"
+};
+
+static const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+    "steps", "samples", "bytes_written", "clamps"
+};
+
+// Reference points for converting ticks to seconds, taken at startup
+static const uint64_t startTicks = now();
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    Totals finished = {};
+    std::vector<ThreadTotals*> live;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+void add(Totals& into, const Totals& from) {
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        into.ticks[i] += from.ticks[i];
+        into.calls[i] += from.calls[i];
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) into.counts[i] += from.counts[i];
+}
+
+}  // namespace
+
+ThreadTotals::ThreadTotals() : Totals() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.live.push_back(this);
+}
+
+ThreadTotals::~ThreadTotals() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    add(r.finished, *this);
+    r.live.erase(std::remove(r.live.begin(), r.live.end(), this), r.live.end());
+}
+
+void report(std::ostream& out, const std::string& jsonFilename) {
+    // Threads still alive (the caller, idle pool workers) are read in place
+    Totals totals = {};
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        totals = r.finished;
+        for (const ThreadTotals* thread : r.live) add(totals, *thread);
+    }
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double ticksPerSecond = wall > 0 ? (now() - startTicks) / wall : 1.0;
+
+    out << "Profile (" << std::fixed << std::setprecision(3) << wall << " s wall, "
+        << std::setprecision(2) << ticksPerSecond * 1e-9 << " GHz timer)" << std::endl;
+    out << "  phase               calls     seconds   share     ns/call" << std::endl;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        double seconds = totals.ticks[i] / ticksPerSecond;
+        double perCall = totals.calls[i] ? seconds * 1e9 / totals.calls[i] : 0.0;
+        out << "  " << std::left << std::setw(14) << PHASE_NAMES[i] << std::right
+            << std::setw(12) << totals.calls[i]
+            << std::setw(12) << std::setprecision(4) << seconds
+            << std::setw(7) << std::setprecision(1) << (wall > 0 ? 100.0 * seconds / wall : 0.0) << "%"
+            << std::setw(12) << std::setprecision(1) << perCall << std::endl;
+    }
+    out << "  (phases on different threads overlap; formatting includes io)" << std::endl;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        out << "  " << std::left << std::setw(14) << COUNTER_NAMES[i] << std::right
+            << std::setw(12) << totals.counts[i] << std::endl;
+    }
+    out.unsetf(std::ios::floatfield);
+
+    if (jsonFilename.empty()) return;
+
+    std::ofstream json(jsonFilename);
+    if (!json.is_open()) {
+        std::cerr << "Cannot create profile file: " << jsonFilename << std::endl;
+        return;
+    }
+    json << std::setprecision(9);
+    json << "{\n  \"wall_seconds\": " << wall << ",\n  \"ticks_per_second\": " << ticksPerSecond
+         << ",\n  \"phases\": {";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        json << (i ? ",\n" : "\n") << "    \"" << PHASE_NAMES[i] << "\": {\"calls\": " << totals.calls[i]
+             << ", \"seconds\": " << totals.ticks[i] / ticksPerSecond << "}";
+    }
+    json << "\n  },\n  \"counters\": {";
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        json << (i ? ",\n" : "\n") << "    \"" << COUNTER_NAMES[i] << "\": " << totals.counts[i];
+    }
+    json << "\n  }\n}\n";
+    out << "Profile saved to: " << jsonFilename << std::endl;
+}
+
+}  // namespace profile
+
+#endif
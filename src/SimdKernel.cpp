@@ -0,0 +1,68 @@
+#include "SimdKernel.hpp"
+#include <stdexcept>
+
+void accelerationBatchScalar(const Config& cfg,
+                             const double* theta1, const double* theta2,
+                             const double* omega1, const double* omega2,
+                             double* alpha1, double* alpha2,
+                             unsigned* flags, size_t n) {
+    // Same policy as DoublePendulum, so SIMD=scalar reproduces it bit for bit
+    KernelCoefficients(cfg).select([&](const auto& params) {
+        for (size_t i = 0; i < n; i++) {
+            flags[i] = DoublePendulum::accelerationKernel(params, theta1[i], theta2[i], omega1[i], omega2[i],
+                                                          alpha1[i], alpha2[i]);
+        }
+    });
+}
+
+SimdLevel detectSimdLevel() {
+#ifdef DP_SIMD_X86
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX2;
+        if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+        return SIMD_SCALAR;
+    }();
+    return level;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+SimdLevel parseSimdLevel(const std::string& name) {
+    SimdLevel requested;
+    if (name.empty() || name == "auto") return detectSimdLevel();
+    else if (name == "scalar") requested = SIMD_SCALAR;
+    else if (name == "sse2") requested = SIMD_SSE2;
+    else if (name == "avx2") requested = SIMD_AVX2;
+    else if (name == "avx512") requested = SIMD_AVX512;
+    else throw std::invalid_argument("Unknown SIMD level: " + name);
+
+    // Never hand out a kernel the host would fault on
+    SimdLevel best = detectSimdLevel();
+    return requested > best ? best : requested;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_SSE2: return "sse2";
+        case SIMD_AVX2: return "avx2";
+        case SIMD_AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+AccelerationBatchFn selectAccelerationKernel(SimdLevel level) {
+#ifdef DP_SIMD_X86
+    switch (level) {
+        case SIMD_SSE2: return accelerationBatchSSE2;
+        case SIMD_AVX2: return accelerationBatchAVX2;
+        case SIMD_AVX512: return accelerationBatchAVX512;
+        default: break;
+    }
+#else
+    (void)level;
+#endif
+    return accelerationBatchScalar;
+}
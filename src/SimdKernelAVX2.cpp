@@ -0,0 +1,58 @@
+#include "SimdKernel.hpp"
+
+#ifdef DP_SIMD_X86
+#include "SimdMath.hpp"
+#include <immintrin.h>
+
+// Built with -mavx2 -mfma (see Makefile). Any inline function from a shared
+// header that got emitted here would carry AVX2 encodings and could be picked
+// by the linker for the whole program, so only intrinsics and the templates in
+// SimdMath.hpp, instantiated on the TU-local traits below, may be used.
+
+namespace {
+
+struct AVX2 {
+    typedef __m256d V;
+    typedef __m256d M;
+    static const size_t WIDTH = 4;
+
+    static V load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    static V set1(double x) { return _mm256_set1_pd(x); }
+
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+    static V min(V a, V b) { return _mm256_min_pd(a, b); }
+    static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    static V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+
+    static M lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static M ge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static V select(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+    static M maskXor(M a, M b) { return _mm256_xor_pd(a, b); }
+
+    static V truncate(V a) { return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+
+    template <int BIT>
+    static M bitSet(V y) {
+        // Adding 2^52 moves the integer value of y into the low mantissa bits
+        __m256i bits = _mm256_castpd_si256(_mm256_add_pd(y, _mm256_set1_pd(4503599627370496.0)));
+        __m256i bit = _mm256_and_si256(_mm256_srli_epi64(bits, BIT), _mm256_set1_epi64x(1));
+        return _mm256_castsi256_pd(_mm256_sub_epi64(_mm256_setzero_si256(), bit));
+    }
+};
+
+}
+
+void accelerationBatchAVX2(const Config& cfg,
+                           const double* theta1, const double* theta2,
+                           const double* omega1, const double* omega2,
+                           double* alpha1, double* alpha2,
+                           unsigned* flags, size_t n) {
+    simdAccelerationBatch<AVX2>(cfg, theta1, theta2, omega1, omega2, alpha1, alpha2, flags, n);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include "SimdKernel.hpp"
+
+#ifdef DP_SIMD_X86
+#include "SimdMath.hpp"
+#include <immintrin.h>
+
+// Built with -mavx512f (see Makefile); the same rules as SimdKernelAVX2.cpp
+// apply. Lane masks live in k registers, so M is __mmask8 here.
+
+namespace {
+
+struct AVX512 {
+    typedef __m512d V;
+    typedef __mmask8 M;
+    static const size_t WIDTH = 8;
+
+    static V load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, V v) { _mm512_storeu_pd(p, v); }
+    static V set1(double x) { return _mm512_set1_pd(x); }
+
+    static V add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm512_div_pd(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+    // Zero-masked forms with a full mask: the unmasked ones pass
+    // _mm512_undefined_pd() through and trip -Wmaybe-uninitialized on GCC 12
+    static V min(V a, V b) { return _mm512_maskz_min_pd(0xFF, a, b); }
+    static V max(V a, V b) { return _mm512_maskz_max_pd(0xFF, a, b); }
+    static V abs(V a) { return _mm512_abs_pd(a); }
+
+    static M lt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static M ge(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+    static V select(M m, V a, V b) { return _mm512_mask_blend_pd(m, b, a); }
+    static M maskXor(M a, M b) { return static_cast<M>(a ^ b); }
+
+    static V truncate(V a) { return _mm512_maskz_roundscale_pd(0xFF, a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+
+    template <int BIT>
+    static M bitSet(V y) {
+        // Adding 2^52 moves the integer value of y into the low mantissa bits
+        __m512i bits = _mm512_castpd_si512(_mm512_add_pd(y, _mm512_set1_pd(4503599627370496.0)));
+        return _mm512_test_epi64_mask(bits, _mm512_set1_epi64(1LL << BIT));
+    }
+};
+
+}
+
+void accelerationBatchAVX512(const Config& cfg,
+                             const double* theta1, const double* theta2,
+                             const double* omega1, const double* omega2,
+                             double* alpha1, double* alpha2,
+                             unsigned* flags, size_t n) {
+    simdAccelerationBatch<AVX512>(cfg, theta1, theta2, omega1, omega2, alpha1, alpha2, flags, n);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "SimdKernel.hpp"
+
+#ifdef DP_SIMD_X86
+#include "SimdMath.hpp"
+#include <emmintrin.h>
+
+// Built with the baseline x86-64 flags. Only intrinsics and the templates
+// in SimdMath.hpp may be used here, see SimdKernelAVX2.cpp.
+
+namespace {
+
+struct SSE2 {
+    typedef __m128d V;
+    typedef __m128d M;
+    static const size_t WIDTH = 2;
+
+    static V load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, V v) { _mm_storeu_pd(p, v); }
+    static V set1(double x) { return _mm_set1_pd(x); }
+
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm_div_pd(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static V min(V a, V b) { return _mm_min_pd(a, b); }
+    static V max(V a, V b) { return _mm_max_pd(a, b); }
+    static V abs(V a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+
+    static M lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+    static M ge(V a, V b) { return _mm_cmpge_pd(a, b); }
+    static V select(M m, V a, V b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+    static M maskXor(M a, M b) { return _mm_xor_pd(a, b); }
+
+    static V truncate(V a) { return _mm_cvtepi32_pd(_mm_cvttpd_epi32(a)); }
+
+    template <int BIT>
+    static M bitSet(V y) {
+        // Adding 2^52 moves the integer value of y into the low mantissa bits
+        __m128i bits = _mm_castpd_si128(_mm_add_pd(y, _mm_set1_pd(4503599627370496.0)));
+        __m128i bit = _mm_and_si128(_mm_srli_epi64(bits, BIT), _mm_set1_epi64x(1));
+        return _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), bit));
+    }
+};
+
+}
+
+void accelerationBatchSSE2(const Config& cfg,
+                           const double* theta1, const double* theta2,
+                           const double* omega1, const double* omega2,
+                           double* alpha1, double* alpha2,
+                           unsigned* flags, size_t n) {
+    simdAccelerationBatch<SSE2>(cfg, theta1, theta2, omega1, omega2, alpha1, alpha2, flags, n);
+}
+
+#endif
@@ -0,0 +1,264 @@
+#include "Stepper.hpp"
+#include "Hamiltonian.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+void Stepper::save(Checkpoint& checkpoint) const {
+    checkpoint.clamps[0] = clampCounters.denominator;
+    checkpoint.clamps[1] = clampCounters.acceleration;
+}
+
+void Stepper::restore(const Checkpoint& checkpoint) {
+    clampCounters.denominator = checkpoint.clamps[0];
+    clampCounters.acceleration = checkpoint.clamps[1];
+}
+
+template <typename Params>
+const PendulumTrig& VerletStepper<Params>::trigOf(const PendulumState& state) {
+    if (state.theta1 != trigTheta1 || state.theta2 != trigTheta2) {
+        trig = PendulumTrig(state.theta1, state.theta2);
+        trigTheta1 = state.theta1;
+        trigTheta2 = state.theta2;
+    }
+    return trig;
+}
+
+template <typename Params>
+void VerletStepper<Params>::start(PendulumState& state) {
+    // First step uses Euler method for initialization
+    // Mathematical formula: $\theta(t-\Delta t) = \theta(t) - \omega(t)\Delta t + \frac{1}{2}\alpha(t)(\Delta t)^2$
+    double alpha1, alpha2;
+    clampCounters.add(DoublePendulum::accelerationKernel(params, trigOf(state),
+                                                         state.omega1, state.omega2, alpha1, alpha2));
+    state.theta1_old = state.theta1 - state.omega1 * config.dt + 0.5 * alpha1 * config.dt * config.dt;
+    state.theta2_old = state.theta2 - state.omega2 * config.dt + 0.5 * alpha2 * config.dt * config.dt;
+    previous = trig;
+}
+
+template <typename Params>
+void VerletStepper<Params>::step(PendulumState& state) {
+    double alpha1, alpha2;
+    clampCounters.add(DoublePendulum::accelerationKernel(params, trigOf(state),
+                                                         state.omega1, state.omega2, alpha1, alpha2));
+
+    double theta1_new = 2 * state.theta1 - state.theta1_old + alpha1 * config.dt * config.dt;
+    double theta2_new = 2 * state.theta2 - state.theta2_old + alpha2 * config.dt * config.dt;
+
+    state.omega1 = (theta1_new - state.theta1_old) / (2 * config.dt);
+    state.omega2 = (theta2_new - state.theta2_old) / (2 * config.dt);
+
+    state.theta1_old = state.theta1;
+    state.theta2_old = state.theta2;
+    state.theta1 = theta1_new;
+    state.theta2 = theta2_new;
+    DoublePendulum::wrapAngle(state.theta1, state.theta1_old);
+    DoublePendulum::wrapAngle(state.theta2, state.theta2_old);
+
+    // The velocities belong to the angles this step started from; the new
+    // ones serve the sample of this state and the next step
+    previous = trig;
+    trigOf(state);
+}
+
+template class VerletStepper<PendulumCoefficients>;
+template class VerletStepper<EqualPendulumCoefficients>;
+
+CompositionStepper::CompositionStepper(const Config& cfg, const std::vector<double>& weights, Base base)
+    : config(cfg), weights(weights), base(base), last(), p1(0.0), p2(0.0) {}
+
+void CompositionStepper::derivatives(const double z[4], double dz[4]) const {
+    hamiltonDerivatives(config, CanonicalTrig(z[0], z[1]), z[2], z[3], dz);
+}
+
+void CompositionStepper::midpoint(double z[4], double h) const {
+    // Solve zm = z + h/2 f(zm) by fixed-point iteration from an explicit
+    // half step; it contracts like (h/2 |f'|)^k
+    const double TOLERANCE = 1e-15;
+    const int MAX_ITERATIONS = 50;
+
+    double dz[4], zm[4];
+    derivatives(z, dz);
+    for (int i = 0; i < 4; i++) zm[i] = z[i] + 0.5 * h * dz[i];
+
+    double change = INFINITY;
+    for (int k = 0; k < MAX_ITERATIONS && change >= TOLERANCE; k++) {
+        derivatives(zm, dz);
+        change = 0.0;
+        for (int i = 0; i < 4; i++) {
+            double next = z[i] + 0.5 * h * dz[i];
+            change = std::max(change, std::abs(next - zm[i]) / (1.0 + std::abs(next)));
+            zm[i] = next;
+        }
+    }
+
+    // Rounding can keep the last digits moving; anything more means the
+    // step is too large for the iteration to contract
+    if (!(change < 1e-12)) {
+        throw std::runtime_error("Implicit midpoint iteration does not converge, reduce DT");
+    }
+
+    // z(t + h) = 2 zm - z
+    for (int i = 0; i < 4; i++) z[i] = 2.0 * zm[i] - z[i];
+}
+
+void CompositionStepper::stormerVerlet(double z[4], double h) const {
+    // $p_{1/2} = p + \frac{h}{2}\dot p(\theta, p_{1/2})$
+    // $\theta' = \theta + \frac{h}{2}(\dot\theta(\theta, p_{1/2}) + \dot\theta(\theta', p_{1/2}))$
+    // $p' = p_{1/2} + \frac{h}{2}\dot p(\theta', p_{1/2})$
+    // Both implicit stages are solved by fixed-point iteration; the first one
+    // keeps the angles fixed, so its trigonometric terms are computed once
+    const double TOLERANCE = 1e-15;
+    const int MAX_ITERATIONS = 50;
+
+    CanonicalTrig trig(z[0], z[1]);
+    double dz[4];
+    hamiltonDerivatives(config, trig, z[2], z[3], dz);
+    double ph1 = z[2] + 0.5 * h * dz[2];
+    double ph2 = z[3] + 0.5 * h * dz[3];
+
+    double change = INFINITY;
+    for (int k = 0; k < MAX_ITERATIONS && change >= TOLERANCE; k++) {
+        hamiltonDerivatives(config, trig, ph1, ph2, dz);
+        double next1 = z[2] + 0.5 * h * dz[2];
+        double next2 = z[3] + 0.5 * h * dz[3];
+        change = std::max(std::abs(next1 - ph1) / (1.0 + std::abs(next1)),
+                          std::abs(next2 - ph2) / (1.0 + std::abs(next2)));
+        ph1 = next1;
+        ph2 = next2;
+    }
+    bool converged = change < 1e-12;
+
+    // Velocities at the old angles, then iterate on the new angles
+    hamiltonDerivatives(config, trig, ph1, ph2, dz);
+    double v1 = dz[0], v2 = dz[1];
+    double th1 = z[0] + h * v1;
+    double th2 = z[1] + h * v2;
+
+    change = INFINITY;
+    for (int k = 0; k < MAX_ITERATIONS && change >= TOLERANCE; k++) {
+        hamiltonDerivatives(config, CanonicalTrig(th1, th2), ph1, ph2, dz);
+        double next1 = z[0] + 0.5 * h * (v1 + dz[0]);
+        double next2 = z[1] + 0.5 * h * (v2 + dz[1]);
+        change = std::max(std::abs(next1 - th1) / (1.0 + std::abs(next1)),
+                          std::abs(next2 - th2) / (1.0 + std::abs(next2)));
+        th1 = next1;
+        th2 = next2;
+    }
+    if (!converged || !(change < 1e-12)) {
+        throw std::runtime_error("Stormer-Verlet iteration does not converge, reduce DT");
+    }
+
+    hamiltonDerivatives(config, CanonicalTrig(th1, th2), ph1, ph2, dz);
+    z[0] = th1;
+    z[1] = th2;
+    z[2] = ph1 + 0.5 * h * dz[2];
+    z[3] = ph2 + 0.5 * h * dz[3];
+}
+
+void CompositionStepper::start(PendulumState& state) {
+    state.theta1_old = state.theta1;
+    state.theta2_old = state.theta2;
+    // Force the first step to derive p from omega
+    last = state;
+    last.omega1 = NAN;
+}
+
+void CompositionStepper::step(PendulumState& state) {
+    double z[4] = {state.theta1, state.theta2, p1, p2};
+
+    // Converting omega -> p -> omega every step would add rounding that is
+    // not symplectic, so keep p while the caller hands back our own state
+    if (state.theta1 != last.theta1 || state.theta2 != last.theta2 ||
+        state.omega1 != last.omega1 || state.omega2 != last.omega2) {
+        canonicalMomenta(config, CanonicalTrig(state.theta1, state.theta2),
+                         state.omega1, state.omega2, z[2], z[3]);
+    }
+
+    for (size_t i = 0; i < weights.size(); i++) {
+        if (base == STORMER_VERLET) {
+            stormerVerlet(z, weights[i] * config.dt);
+        } else {
+            midpoint(z, weights[i] * config.dt);
+        }
+    }
+
+    double dz[4];
+    derivatives(z, dz);
+
+    state.theta1_old = state.theta1;
+    state.theta2_old = state.theta2;
+    state.theta1 = z[0];
+    state.theta2 = z[1];
+    DoublePendulum::wrapAngle(state.theta1, state.theta1_old);
+    DoublePendulum::wrapAngle(state.theta2, state.theta2_old);
+    state.omega1 = dz[0];
+    state.omega2 = dz[1];
+
+    last = state;
+    p1 = z[2];
+    p2 = z[3];
+}
+
+void CompositionStepper::save(Checkpoint& checkpoint) const {
+    Stepper::save(checkpoint);
+    const double words[6] = {last.theta1, last.theta2, last.omega1, last.omega2, p1, p2};
+    std::copy(words, words + 6, checkpoint.stepper);
+}
+
+void CompositionStepper::restore(const Checkpoint& checkpoint) {
+    Stepper::restore(checkpoint);
+    const double* words = checkpoint.stepper;
+    last.theta1 = words[0];
+    last.theta2 = words[1];
+    last.omega1 = words[2];
+    last.omega2 = words[3];
+    p1 = words[4];
+    p2 = words[5];
+}
+
+// Symmetric weights of the Yoshida compositions, listed from the outside in;
+// the middle weight makes them sum to 1
+static std::vector<double> symmetricWeights(const std::vector<double>& outer) {
+    double sum = 0.0;
+    for (double w : outer) sum += w;
+
+    std::vector<double> weights(outer);
+    weights.push_back(1.0 - 2.0 * sum);
+    weights.insert(weights.end(), outer.rbegin(), outer.rend());
+    return weights;
+}
+
+std::unique_ptr<Stepper> createStepper(const Config& cfg) {
+    const std::string& method = cfg.method;
+
+    if (method == "verlet") {
+        // The policy KernelCoefficients selects, as a template argument
+        return KernelCoefficients(cfg).select([&](const auto& params) {
+            typedef typename std::decay<decltype(params)>::type Params;
+            return std::unique_ptr<Stepper>(new VerletStepper<Params>(cfg));
+        });
+    }
+
+    if (method == "midpoint") {
+        return std::unique_ptr<Stepper>(new CompositionStepper(cfg, {1.0}, CompositionStepper::IMPLICIT_MIDPOINT));
+    }
+    if (method == "stormer-verlet") {
+        return std::unique_ptr<Stepper>(new CompositionStepper(cfg, {1.0}, CompositionStepper::STORMER_VERLET));
+    }
+
+    std::vector<double> outer;
+    if (method == "forest-ruth" || method == "yoshida4") {
+        outer = {1.0 / (2.0 - std::cbrt(2.0))};
+    } else if (method == "yoshida6") {
+        outer = {0.784513610477560, 0.235573213359357, -1.17767998417887};
+    } else if (method == "yoshida8") {
+        outer = {0.914844246229740, 0.253693336566229, -1.44485223686048, -0.158240635368243,
+                 1.93813913762276, -1.96061023297549, 0.102799849391985};
+    } else {
+        throw std::invalid_argument("Unknown METHOD: " + method);
+    }
+    return std::unique_ptr<Stepper>(new CompositionStepper(cfg, symmetricWeights(outer),
+                                                         CompositionStepper::IMPLICIT_MIDPOINT));
+}
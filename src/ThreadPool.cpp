@@ -0,0 +1,125 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads)
+    : job(nullptr), remaining(0), generation(0), stopping(false) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+
+    // Queue 0 belongs to the thread calling parallelFor
+    for (unsigned i = 1; i < threads; i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wakeWorkers.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        runTasks(self);
+    }
+}
+
+bool ThreadPool::popTask(size_t self, size_t& task) {
+    WorkerQueue& queue = *queues[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::stealTask(size_t self, size_t& task) {
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        WorkerQueue& victim = *queues[(self + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTasks(size_t self) {
+    size_t task;
+    while (popTask(self, task) || stealTask(self, task)) {
+        try {
+            (*job)(task);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (!failure) failure = std::current_exception();
+        }
+
+        if (remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            jobDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t tasks, const std::function<void(size_t)>& fn) {
+    if (tasks == 0) return;
+
+    // Publish the job before any task becomes visible: a worker still
+    // draining the previous job may pick up a new task right away
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        job = &fn;
+        remaining = tasks;
+        failure = nullptr;
+    }
+
+    // Deal tasks out in contiguous runs so neighbouring chunks, which touch
+    // neighbouring memory, start on the same worker
+    size_t perWorker = (tasks + queues.size() - 1) / queues.size();
+    for (size_t w = 0; w < queues.size(); w++) {
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        size_t begin = std::min(tasks, w * perWorker);
+        size_t end = std::min(tasks, begin + perWorker);
+        // Stored reversed so that popping from the back runs them in order
+        for (size_t t = end; t > begin; t--) {
+            queues[w]->tasks.push_back(t - 1);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        generation++;
+    }
+    wakeWorkers.notify_all();
+
+    runTasks(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        jobDone.wait(lock, [&]() { return remaining.load() == 0; });
+        job = nullptr;
+        error = failure;
+    }
+    if (error) std::rethrow_exception(error);
+}
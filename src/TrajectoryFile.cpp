@@ -0,0 +1,266 @@
+#include "TrajectoryFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char* const SAMPLE_COLUMNS[] = {"t", "x1", "y1", "x2", "y2", "theta1", "theta2"};
+static const size_t SAMPLE_COLUMN_COUNT = sizeof(SAMPLE_COLUMNS) / sizeof(SAMPLE_COLUMNS[0]);
+
+BinaryTrajectoryWriter::BinaryTrajectoryWriter() : file(nullptr), fill(0), failed(false) {
+    std::memset(&header, 0, sizeof(header));
+}
+
+BinaryTrajectoryWriter::~BinaryTrajectoryWriter() {
+    close();
+}
+
+bool BinaryTrajectoryWriter::open(const std::string& filename, const Config& config,
+                                  size_t blockSamples) {
+    close();
+
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file) return false;
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.columnCount = SAMPLE_COLUMN_COUNT;
+    header.blockSamples = blockSamples;
+    header.sampleCount = 0;
+    header.byteOrder = TRAJECTORY_BYTE_ORDER;
+
+    const double values[11] = {config.L1, config.L2, config.M1, config.M2, config.G,
+                               config.theta1, config.theta2, config.omega1, config.omega2,
+                               config.dt, config.totalTime};
+    std::memcpy(header.config, values, sizeof(values));
+    for (size_t c = 0; c < SAMPLE_COLUMN_COUNT; c++) {
+        std::strncpy(header.columnNames[c], SAMPLE_COLUMNS[c], sizeof(header.columnNames[c]));
+    }
+
+    block.assign(SAMPLE_COLUMN_COUNT * blockSamples, 0.0);
+    fill = 0;
+    failed = false;
+
+    // Provisional header, sampleCount is patched in close()
+    DP_PROFILE_COUNT(BYTES_WRITTEN, sizeof(header));
+    writeAll(&header, sizeof(header), 1);
+    return !failed;
+}
+
+bool BinaryTrajectoryWriter::resume(const std::string& filename, const Checkpoint& checkpoint) {
+    close();
+
+    file = std::fopen(filename.c_str(), "r+b");
+    if (!file) return false;
+
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.byteOrder != TRAJECTORY_BYTE_ORDER || header.columnCount != SAMPLE_COLUMN_COUNT ||
+        header.blockSamples == 0 || header.sampleCount < checkpoint.output[0]) {
+        close();
+        return false;
+    }
+
+    // Reload the partial block the checkpoint wrote and continue filling it
+    const size_t n = header.blockSamples;
+    header.sampleCount = checkpoint.output[0];
+    fill = header.sampleCount % n;
+    failed = false;
+    block.assign(SAMPLE_COLUMN_COUNT * n, 0.0);
+    long blockStart = static_cast<long>(sizeof(header) + (header.sampleCount / n) * block.size() * sizeof(double));
+    std::fseek(file, blockStart, SEEK_SET);
+    if (fill > 0 && std::fread(block.data(), sizeof(double), block.size(), file) != block.size()) {
+        close();
+        return false;
+    }
+    std::fflush(file);
+    if (::ftruncate(fileno(file), blockStart + (fill > 0 ? block.size() * sizeof(double) : 0)) != 0) {
+        close();
+        return false;
+    }
+    std::fseek(file, blockStart, SEEK_SET);
+    return true;
+}
+
+void BinaryTrajectoryWriter::append(const Sample& sample) {
+    const size_t n = header.blockSamples;
+    block[0 * n + fill] = sample.t;
+    block[1 * n + fill] = sample.x1;
+    block[2 * n + fill] = sample.y1;
+    block[3 * n + fill] = sample.x2;
+    block[4 * n + fill] = sample.y2;
+    block[5 * n + fill] = sample.theta1;
+    block[6 * n + fill] = sample.theta2;
+    header.sampleCount++;
+
+    if (++fill == n) flushBlock();
+}
+
+void BinaryTrajectoryWriter::write(const Sample* samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        append(samples[i]);
+    }
+}
+
+void BinaryTrajectoryWriter::writeAll(const void* data, size_t size, size_t count) {
+    if (failed || std::fwrite(data, size, count, file) == count) return;
+    // Report once, like AsciiEmitter; close() returns the failure
+    std::cerr << "Error writing output file" << std::endl;
+    failed = true;
+}
+
+void BinaryTrajectoryWriter::writeBlock() {
+    // Zero the unused tail so a partial last block has defined contents
+    const size_t n = header.blockSamples;
+    for (size_t c = 0; c < header.columnCount; c++) {
+        std::fill(block.begin() + c * n + fill, block.begin() + (c + 1) * n, 0.0);
+    }
+    DP_PROFILE_SCOPE(IO);
+    DP_PROFILE_COUNT(BYTES_WRITTEN, block.size() * sizeof(double));
+    writeAll(block.data(), sizeof(double), block.size());
+}
+
+void BinaryTrajectoryWriter::flushBlock() {
+    if (fill == 0) return;
+    writeBlock();
+    fill = 0;
+}
+
+void BinaryTrajectoryWriter::checkpoint(Checkpoint& checkpoint) {
+    long blockStart = std::ftell(file);
+    if (fill > 0) writeBlock();
+    std::fseek(file, 0, SEEK_SET);
+    writeAll(&header, sizeof(header), 1);
+    std::fflush(file);
+    {
+        DP_PROFILE_SCOPE(IO);
+        ::fdatasync(fileno(file));
+    }
+    std::fseek(file, blockStart, SEEK_SET);
+    checkpoint.output[0] = header.sampleCount;
+    checkpoint.output[1] = 0;
+}
+
+bool BinaryTrajectoryWriter::close() {
+    if (!file) return !failed;
+
+    flushBlock();
+    std::fseek(file, 0, SEEK_SET);
+    writeAll(&header, sizeof(header), 1);
+    // Buffered data is written by fclose, so its result counts too
+    if (std::fclose(file) != 0) failed = true;
+    file = nullptr;
+    return !failed;
+}
+
+TrajectoryReader::TrajectoryReader() : base(nullptr), length(0), header(nullptr) {
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    close();
+}
+
+void TrajectoryReader::open(const std::string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open trajectory file: " + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TrajectoryHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a trajectory file: " + filename);
+    }
+
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Cannot map trajectory file: " + filename);
+    }
+
+    base = static_cast<const unsigned char*>(mapping);
+    length = st.st_size;
+    header = reinterpret_cast<const TrajectoryHeader*>(base);
+
+    if (std::memcmp(header->magic, TRAJECTORY_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRAJECTORY_VERSION) {
+        close();
+        throw std::runtime_error("Not a trajectory file: " + filename);
+    }
+    if (header->byteOrder != TRAJECTORY_BYTE_ORDER) {
+        close();
+        throw std::runtime_error("Trajectory file written in the other byte order: " + filename);
+    }
+    if (header->blockSamples == 0 ||
+        header->columnCount == 0 ||
+        header->columnCount > sizeof(header->columnNames) / sizeof(header->columnNames[0])) {
+        close();
+        throw std::runtime_error("Not a trajectory file: " + filename);
+    }
+
+    // The data section holds whole rows of columnCount doubles
+    const size_t rowBytes = columnCount() * sizeof(double);
+    const size_t dataBytes = length - sizeof(TrajectoryHeader);
+    if (dataBytes % rowBytes != 0) {
+        close();
+        throw std::runtime_error("Damaged trajectory file: " + filename);
+    }
+
+    // Compared by division, so a damaged header cannot overflow the product
+    const size_t rows = dataBytes / rowBytes;
+    if (blockCount() > rows / blockSamples()) {
+        close();
+        throw std::runtime_error("Truncated trajectory file: " + filename);
+    }
+
+    // Columns are read front to back
+    madvise(mapping, length, MADV_SEQUENTIAL);
+}
+
+void TrajectoryReader::close() {
+    if (base) {
+        munmap(const_cast<unsigned char*>(base), length);
+    }
+    base = nullptr;
+    length = 0;
+    header = nullptr;
+}
+
+int TrajectoryReader::columnIndex(const std::string& name) const {
+    for (size_t c = 0; c < columnCount(); c++) {
+        if (name.compare(0, std::string::npos, header->columnNames[c],
+                         strnlen(header->columnNames[c], sizeof(header->columnNames[c]))) == 0) {
+            return static_cast<int>(c);
+        }
+    }
+    return -1;
+}
+
+const double* TrajectoryReader::column(size_t block, size_t column) const {
+    const double* data = reinterpret_cast<const double*>(base + sizeof(TrajectoryHeader));
+    return data + (block * columnCount() + column) * blockSamples();
+}
+
+Config TrajectoryReader::config() const {
+    Config cfg;
+    const double* v = header->config;
+    cfg.L1 = v[0];
+    cfg.L2 = v[1];
+    cfg.M1 = v[2];
+    cfg.M2 = v[3];
+    cfg.G = v[4];
+    cfg.theta1 = v[5];
+    cfg.theta2 = v[6];
+    cfg.omega1 = v[7];
+    cfg.omega2 = v[8];
+    cfg.dt = v[9];
+    cfg.totalTime = v[10];
+    return cfg;
+}
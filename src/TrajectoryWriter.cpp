@@ -0,0 +1,181 @@
+#include "TrajectoryWriter.hpp"
+#include <iostream>
+#include <sstream>
+
+// Comment lines describing the run, formatted like the original ofstream output
+static std::string textHeader(const char* title, const std::string& format, const Config& config) {
+    std::ostringstream header;
+    header << "# " << title << "\n";
+    header << "# L1=" << config.L1 << " L2=" << config.L2 << "\n";
+    header << "# M1=" << config.M1 << " M2=" << config.M2 << "\n";
+    header << "# G=" << config.G << " dt=" << config.dt << "\n";
+    header << "# Data format: " << format << "\n";
+    return header.str();
+}
+
+bool TextTrajectoryWriter::open(const std::string& positionFilename, const std::string& angleFilename,
+                                const Config& config) {
+    writeAngles = !angleFilename.empty();
+    writeEnergy = config.energy == "columns";
+
+    if (!positionFile.open(positionFilename)) {
+        std::cerr << "Cannot create position file: " << positionFilename << std::endl;
+        return false;
+    }
+
+    if (writeAngles && !angleFile.open(angleFilename)) {
+        std::cerr << "Cannot create angle file: " << angleFilename << std::endl;
+        return false;
+    }
+
+    positionFile.setPrecision(config.precision);
+    angleFile.setPrecision(config.precision);
+
+    // Write file headers with configuration information; the energy columns
+    // go to the angle file when there is one
+    const char* energyColumns = writeEnergy ? " kinetic potential total" : "";
+    positionFile.put(textHeader(writeAngles ? "Double Pendulum Simulation Data - Positions"
+                                            : "Double Pendulum Simulation Data",
+                                std::string("time x1 y1 x2 y2") + (writeAngles ? "" : energyColumns),
+                                config));
+    if (writeAngles) {
+        angleFile.put(textHeader("Double Pendulum Simulation Data - Angles",
+                                 std::string("time theta1 theta2") + energyColumns, config));
+    }
+    return true;
+}
+
+bool TextTrajectoryWriter::resume(const std::string& positionFilename, const std::string& angleFilename,
+                                  const Config& config, const Checkpoint& checkpoint) {
+    writeAngles = !angleFilename.empty();
+    writeEnergy = config.energy == "columns";
+
+    // The headers are already there
+    if (!positionFile.openAt(positionFilename, checkpoint.output[0])) {
+        std::cerr << "Cannot reopen position file: " << positionFilename << std::endl;
+        return false;
+    }
+
+    if (writeAngles && !angleFile.openAt(angleFilename, checkpoint.output[1])) {
+        std::cerr << "Cannot reopen angle file: " << angleFilename << std::endl;
+        return false;
+    }
+
+    positionFile.setPrecision(config.precision);
+    angleFile.setPrecision(config.precision);
+    return true;
+}
+
+void TextTrajectoryWriter::write(const Sample* samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const Sample& s = samples[i];
+        positionFile.put(s.t);
+        positionFile.put(' ');
+        positionFile.put(s.x1);
+        positionFile.put(' ');
+        positionFile.put(s.y1);
+        positionFile.put(' ');
+        positionFile.put(s.x2);
+        positionFile.put(' ');
+        positionFile.put(s.y2);
+        if (writeAngles) {
+            positionFile.put('\n');
+            angleFile.put(s.t);
+            angleFile.put(' ');
+            angleFile.put(s.theta1);
+            angleFile.put(' ');
+            angleFile.put(s.theta2);
+        }
+        AsciiEmitter& last = writeAngles ? angleFile : positionFile;
+        if (writeEnergy) {
+            last.put(' ');
+            last.put(s.kinetic);
+            last.put(' ');
+            last.put(s.potential);
+            last.put(' ');
+            last.put(s.kinetic + s.potential);
+        }
+        last.put('\n');
+    }
+}
+
+void TextTrajectoryWriter::checkpoint(Checkpoint& checkpoint) {
+    positionFile.sync();
+    angleFile.sync();
+    checkpoint.output[0] = positionFile.getBytesWritten();
+    checkpoint.output[1] = angleFile.getBytesWritten();
+}
+
+bool TextTrajectoryWriter::close() {
+    bool positions = positionFile.close();
+    bool angles = angleFile.close();
+    return positions && angles;
+}
+
+AsyncTrajectoryWriter::AsyncTrajectoryWriter(TrajectoryWriter& sink, size_t bufferSamples, size_t bufferCount)
+    : sink(sink), buffers(bufferCount), filled(bufferCount), recycled(bufferCount),
+      current(nullptr), submitted(0), written(0), finished(false) {
+    for (size_t i = 0; i < buffers.size(); i++) {
+        buffers[i].samples.resize(bufferSamples);
+        buffers[i].count = 0;
+        if (i > 0) recycled.push(&buffers[i]);
+    }
+    current = &buffers[0];
+
+    thread = std::thread(&AsyncTrajectoryWriter::writerLoop, this);
+}
+
+AsyncTrajectoryWriter::~AsyncTrajectoryWriter() {
+    close();
+}
+
+void AsyncTrajectoryWriter::submit() {
+    spaceReady.wait([&] { return filled.push(current); });
+    dataReady.notify();
+    submitted++;
+
+    spaceReady.wait([&] { return recycled.pop(current); });
+    current->count = 0;
+}
+
+void AsyncTrajectoryWriter::writerLoop() {
+    while (true) {
+        SampleBuffer* buffer;
+        bool available = false;
+        dataReady.wait([&] {
+            available = filled.pop(buffer);
+            return available || finished.load(std::memory_order_acquire);
+        });
+
+        // finished is set after the last push, so an empty ring is final
+        if (!available && !filled.pop(buffer)) return;
+        {
+            DP_PROFILE_SCOPE(FORMATTING);
+            sink.write(buffer->samples.data(), buffer->count);
+        }
+        written.fetch_add(1, std::memory_order_release);
+        recycled.push(buffer);
+        spaceReady.notify();
+    }
+}
+
+void AsyncTrajectoryWriter::checkpoint(Checkpoint& checkpoint) {
+    if (current->count > 0) submit();
+
+    // Once the writer thread is done with every buffer it sleeps on the
+    // empty ring, so the sink can be used from this thread
+    spaceReady.wait([&] { return written.load(std::memory_order_acquire) == submitted; });
+    sink.checkpoint(checkpoint);
+}
+
+void AsyncTrajectoryWriter::close() {
+    if (!thread.joinable()) return;
+
+    if (current->count > 0) {
+        spaceReady.wait([&] { return filled.push(current); });
+        current = nullptr;
+    }
+    finished.store(true, std::memory_order_release);
+    dataReady.notify();
+    thread.join();
+}
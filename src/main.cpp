@@ -1,18 +1,32 @@
 #include "DoublePendulum.hpp"
+#include "Lyapunov.hpp"
+#include "PoincareSection.hpp"
+#include "ParameterSweep.hpp"
 #include <iostream>
 #include <string>
+#include <vector>
+#include <stdexcept>
 
 int main(int argc, char* argv[]) {
     std::string configFile = "./config/config";
     std::string positionDataFile = "pendulum_data.txt";
     std::string angleDataFile = "pendulum_angles.txt";
+    bool resume = false;
 
-    // Parse command line arguments
-    if (argc >= 2) {
-        configFile = argv[1];
+    // Parse command line arguments; --resume may appear anywhere
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--resume") {
+            resume = true;
+        } else {
+            args.push_back(argv[i]);
+        }
     }
-    if (argc >= 3) {
-        positionDataFile = argv[2];
+    if (args.size() >= 1) {
+        configFile = args[0];
+    }
+    if (args.size() >= 2) {
+        positionDataFile = args[1];
         // Generate angle data filename based on position data filename
         size_t lastDot = positionDataFile.find_last_of('.');
         if (lastDot != std::string::npos) {
@@ -21,20 +35,70 @@ int main(int argc, char* argv[]) {
             angleDataFile = positionDataFile + "_angles";
         }
     }
-    if (argc >= 4) {
-        angleDataFile = argv[3];
+    if (args.size() >= 3) {
+        angleDataFile = args[2];
     }
     
     try {
         // Load configuration
         Config config = DoublePendulum::loadConfig(configFile);
+        if (resume && (!config.sweep.empty() || config.lyapunov != "off" || config.poincare != "off")) {
+            throw std::invalid_argument("--resume applies to trajectory runs only");
+        }
+
+        if (!config.sweep.empty()) {
+            // Ranges in the config: one batched ensemble, one line per member
+            ParameterSweep sweep(config);
+            ThreadPool pool(config.threads > 0 ? config.threads : 0);
+            sweep.run(pool);
+            if (!sweep.write(positionDataFile)) return 1;
+            DP_PROFILE_REPORT(std::cout, config.profileOutput);
+            return 0;
+        }
+
+        if (config.lyapunov == "largest") {
+            // Running exponent only, no trajectory output
+            LyapunovEstimator estimator(config);
+            if (!estimator.run(positionDataFile)) return 1;
+            DP_PROFILE_REPORT(std::cout, config.profileOutput);
+            return 0;
+        } else if (config.lyapunov == "spectrum") {
+            // All four exponents from the variational equations
+            LyapunovSpectrum spectrum(config);
+            if (!spectrum.run(positionDataFile)) return 1;
+            DP_PROFILE_REPORT(std::cout, config.profileOutput);
+            return 0;
+        } else if (config.lyapunov != "off") {
+            throw std::invalid_argument("Unknown LYAPUNOV: " + config.lyapunov);
+        }
+
+        if (config.poincare != "off") {
+            // Section crossings only
+            PoincareSection section(config);
+            if (!section.run(positionDataFile)) return 1;
+            DP_PROFILE_REPORT(std::cout, config.profileOutput);
+            return 0;
+        }
 
         // Create double pendulum object
         DoublePendulum pendulum(config);
+        if (resume) {
+            // Continue an interrupted run from its CHECKPOINT file
+            pendulum.resumeFromCheckpoint();
+        }
 
-        // Run simulation and output both position and angle data
-        pendulum.simulateAndOutputAllData(positionDataFile, angleDataFile);
+        if (config.outputFormat == "binary") {
+            // Positions and angles share one columnar file
+            pendulum.simulateAndOutputBinaryData(positionDataFile);
+        } else if (config.outputFormat == "text") {
+            // Run simulation and output both position and angle data
+            pendulum.simulateAndOutputAllData(positionDataFile, angleDataFile);
+        } else {
+            throw std::invalid_argument("Unknown OUTPUT_FORMAT: " + config.outputFormat);
+        }
         
+        // Phase breakdown, only in make PROFILE=1 builds
+        DP_PROFILE_REPORT(std::cout, config.profileOutput);
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -12,6 +12,62 @@ import sys
 import os
 from PIL import Image
 import glob
+import struct
+
+# Binary columnar trajectory format written with OUTPUT_FORMAT=binary
+# (see include/TrajectoryFile.hpp for the layout)
+TRAJECTORY_MAGIC = b'DPTRAJ\x00\x00'
+TRAJECTORY_HEADER_SIZE = 256
+TRAJECTORY_BYTE_ORDER = 0x01020304
+TRAJECTORY_BYTE_ORDER_OFFSET = 248
+TRAJECTORY_CONFIG_KEYS = ['L1', 'L2', 'M1', 'M2', 'G', 'THETA1', 'THETA2',
+                          'OMEGA1', 'OMEGA2', 'dt', 'TOTAL_TIME']
+
+def is_binary_trajectory(filename):
+    """Check whether a file uses the binary columnar trajectory format"""
+    try:
+        with open(filename, 'rb') as f:
+            return f.read(len(TRAJECTORY_MAGIC)) == TRAJECTORY_MAGIC
+    except OSError:
+        return False
+
+def open_binary_trajectory(filename):
+    """Memory-map a binary trajectory file without reading it.
+
+    Returns (columns, config_info, blocks) where blocks is a read-only
+    (block, column, sample) memmap and columns maps each column name to its
+    index in the second axis.
+    """
+    with open(filename, 'rb') as f:
+        header = f.read(TRAJECTORY_HEADER_SIZE)
+
+    # The writer uses its own byte order and records it in byteOrder
+    order = '<' if struct.unpack_from('<I', header, TRAJECTORY_BYTE_ORDER_OFFSET)[0] == TRAJECTORY_BYTE_ORDER else '>'
+    version, column_count, block_samples, sample_count = struct.unpack_from(order + 'IIQQ', header, 8)
+    config_values = struct.unpack_from(order + '11d', header, 32)
+    names = [header[120 + 8 * c:128 + 8 * c].split(b'\x00')[0].decode() for c in range(column_count)]
+
+    block_count = (sample_count + block_samples - 1) // block_samples
+    blocks = np.memmap(filename, dtype=order + 'f8', mode='r', offset=TRAJECTORY_HEADER_SIZE,
+                       shape=(block_count, column_count, block_samples))
+    config_info = dict(zip(TRAJECTORY_CONFIG_KEYS, config_values))
+    config_info['samples'] = sample_count
+    return {name: c for c, name in enumerate(names)}, config_info, blocks
+
+def read_binary_trajectory(filename):
+    """Read position and angle arrays from a binary trajectory file"""
+    print("Mapping binary trajectory file...")
+    columns, config_info, blocks = open_binary_trajectory(filename)
+    count = config_info['samples']
+
+    def column(name):
+        # A single block is returned as a view; several blocks are joined
+        return blocks[:, columns[name], :].reshape(-1)[:count]
+
+    data = np.column_stack([column(name) for name in ('t', 'x1', 'y1', 'x2', 'y2')])
+    angle_data = np.column_stack([column(name) for name in ('t', 'theta1', 'theta2')])
+    print(f"Binary trajectory mapped! Total data points: {count}")
+    return data, angle_data, config_info
 
 def read_pendulum_data(filename):
     """Read double pendulum position data file"""
@@ -312,7 +368,10 @@ def main():
     print("Double Pendulum Data Visualization Tool")
     print("=====================================")
     print(f"Position data file: {args.data_file}")
-    if args.angle_file:
+    binary_input = is_binary_trajectory(args.data_file)
+    if binary_input:
+        print("Angle data: stored in the binary trajectory file")
+    elif args.angle_file:
         print(f"Angle data file: {args.angle_file}")
     else:
         # Try to guess angle file name from position file name
@@ -327,12 +386,15 @@ def main():
     print(f"Mode: {'Animation' if args.animate else 'Static plot'}")
     
     # Read position data
-    data, config_info = read_pendulum_data(args.data_file)
+    angle_data = None
+    if binary_input:
+        data, angle_data, config_info = read_binary_trajectory(args.data_file)
+    else:
+        data, config_info = read_pendulum_data(args.data_file)
     print(f"Number of position data points: {len(data)}")
     
     # Read angle data (optional)
-    angle_data = None
-    if args.angle_file:
+    if args.angle_file and not binary_input:
         angle_data, angle_config_info = read_angle_data(args.angle_file)
         if angle_data is not None:
             print(f"Number of angle data points: {len(angle_data)}")